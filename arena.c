@@ -0,0 +1,142 @@
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include "arena.h"
+
+#define ARENA_ALIGN 16
+
+struct arena_block_tag {
+  struct arena_block_tag *next;
+  size_t size;
+  size_t used;
+  /* ARENA_ALIGN-aligned data follows the header */
+};
+typedef struct arena_block_tag arena_block_t;
+
+static size_t align_up(size_t n)
+{
+  return (n + ARENA_ALIGN - 1) & ~((size_t) ARENA_ALIGN - 1);
+}
+
+static char *block_data(arena_block_t *block)
+{
+  return (char *) block + align_up(sizeof(*block));
+}
+
+static arena_block_t *add_block(arena_t *arena, size_t min_size)
+{
+  size_t size = arena->block_size;
+  if (size < min_size) size = min_size;
+  arena_block_t *block = malloc(align_up(sizeof(*block)) + size);
+  if (block == NULL)
+  {
+    fprintf(stderr, "Failed to allocate memory for arena block. Error: %d\n", errno);
+    return NULL;
+  }
+  block->size = size;
+  block->used = 0;
+  block->next = arena->blocks;
+  arena->blocks = block;
+  return block;
+}
+
+arena_t *init_arena(size_t block_size)
+/* Creates an empty arena whose blocks hold block_size bytes (0 for the
+ * default). Requests larger than a block get a block of their own.
+ */
+{
+  arena_t *arena = malloc(sizeof(*arena));
+  if (arena == NULL)
+  {
+    fprintf(stderr, "Failed to allocate memory for arena. Error: %d\n", errno);
+    return NULL;
+  }
+  arena->blocks = NULL;
+  arena->block_size = block_size > 0 ? block_size : ARENA_DEFAULT_BLOCK_SIZE;
+  arena->last = NULL;
+  return arena;
+}
+
+void *arena_alloc(arena_t *arena, size_t size)
+{
+  size = align_up(size > 0 ? size : 1);
+  arena_block_t *block = arena->blocks;
+  if (block == NULL || block->size - block->used < size)
+  {
+    block = add_block(arena, size);
+    if (block == NULL) return NULL;
+  }
+  void *p = block_data(block) + block->used;
+  block->used += size;
+  arena->last = p;
+  return p;
+}
+
+void *arena_realloc(arena_t *arena, void *old, size_t old_size, size_t new_size)
+/* Grows an allocation. The most recent allocation is extended in place when
+ * its block has room; otherwise the contents are copied to a new allocation
+ * and the old space is only reclaimed when the arena is reset.
+ */
+{
+  if (old == NULL) return arena_alloc(arena, new_size);
+  arena_block_t *block = arena->blocks;
+  if (old == arena->last && block != NULL)
+  {
+    size_t start = (char *) old - block_data(block);
+    if (start + align_up(new_size) <= block->size)
+    {
+      block->used = start + align_up(new_size);
+      return old;
+    }
+  }
+  void *p = arena_alloc(arena, new_size);
+  if (p != NULL)
+  {
+    memcpy(p, old, old_size < new_size ? old_size : new_size);
+  }
+  return p;
+}
+
+void reset_arena(arena_t *arena)
+/* Releases everything allocated from the arena but keeps its largest block
+ * so a worker reusing the arena for the next scenario does not go back to
+ * malloc.
+ */
+{
+  arena_block_t *keep = NULL;
+  arena_block_t *block = arena->blocks;
+  while (block != NULL)
+  {
+    arena_block_t *next = block->next;
+    if (keep == NULL || block->size > keep->size)
+    {
+      free(keep);
+      keep = block;
+    }
+    else
+    {
+      free(block);
+    }
+    block = next;
+  }
+  if (keep != NULL)
+  {
+    keep->next = NULL;
+    keep->used = 0;
+  }
+  arena->blocks = keep;
+  arena->last = NULL;
+}
+
+void free_arena(arena_t *arena)
+{
+  if (arena == NULL) return;
+  arena_block_t *block = arena->blocks;
+  while (block != NULL)
+  {
+    arena_block_t *next = block->next;
+    free(block);
+    block = next;
+  }
+  free(arena);
+}
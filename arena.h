@@ -0,0 +1,25 @@
+#ifndef ARENA_H
+#define ARENA_H
+#include <stdlib.h>
+
+/* A region allocator. Memory is carved sequentially out of large blocks and
+ * is never freed piece by piece: everything allocated from an arena is
+ * released at once by reset_arena (which keeps one block for reuse) or
+ * free_arena. A whole parsed scenario can live in one arena.
+ */
+struct arena_block_tag;
+struct arena_tag {
+  struct arena_block_tag *blocks;  /* most recently added block first */
+  size_t block_size;
+  void *last;                      /* most recent allocation, for arena_realloc */
+};
+typedef struct arena_tag arena_t;
+
+#define ARENA_DEFAULT_BLOCK_SIZE 65536
+
+arena_t *init_arena(size_t block_size);
+void *arena_alloc(arena_t *arena, size_t size);
+void *arena_realloc(arena_t *arena, void *old, size_t old_size, size_t new_size);
+void reset_arena(arena_t *arena);
+void free_arena(arena_t *arena);
+#endif
@@ -0,0 +1,321 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "cards.h"
+#include "cardset.h"
+#include "deck.h"
+#include "eval.h"
+#include "future.h"
+#include "input.h"
+#include "rng.h"
+#include "sim.h"
+#include "strength.h"
+
+/*
+   Micro- and macro-benchmarks for the evaluation, deck and input code.
+
+   Every corpus is generated from a fixed seed, so runs are comparable across
+   builds. For each benchmark the harness reports the time per operation,
+   operations per second and heap allocations per operation. Allocations are
+   counted by wrapping malloc, calloc and realloc at link time (see the
+   poker-bench rule in the Makefile); allocations made inside the C library
+   itself (for example by getline) are not seen.
+*/
+
+#define CORPUS_SEED 20241017
+#define N_HANDS 4096
+
+static unsigned long long n_allocs = 0;
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *p, size_t size);
+
+void *__wrap_malloc(size_t size)
+{
+    __atomic_add_fetch(&n_allocs, 1, __ATOMIC_RELAXED);
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t n, size_t size)
+{
+    __atomic_add_fetch(&n_allocs, 1, __ATOMIC_RELAXED);
+    return __real_calloc(n, size);
+}
+
+void *__wrap_realloc(void *p, size_t size)
+{
+    __atomic_add_fetch(&n_allocs, 1, __ATOMIC_RELAXED);
+    return __real_realloc(p, size);
+}
+
+static struct timespec start_time;
+static unsigned long long start_allocs;
+static volatile unsigned long long sink;
+
+static void bench_start(void)
+{
+    start_allocs = __atomic_load_n(&n_allocs, __ATOMIC_RELAXED);
+    clock_gettime(CLOCK_MONOTONIC, &start_time);
+}
+
+static void bench_stop(const char *name, unsigned long long n_ops)
+{
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    unsigned long long allocs = __atomic_load_n(&n_allocs, __ATOMIC_RELAXED) - start_allocs;
+    double ns = (end.tv_sec - start_time.tv_sec) * 1e9 + (end.tv_nsec - start_time.tv_nsec);
+    printf("%-24s %12llu %12.1f %14.0f %10.2f\n", name, n_ops, ns / n_ops,
+           n_ops / (ns / 1e9), (double) allocs / n_ops);
+}
+
+static deck_t *random_hand(rng_t *rng, size_t n_cards)
+{
+    deck_t *hand = initialize_deck();
+    cardset_t used = CARDSET_EMPTY;
+    while (hand->n_cards < n_cards)
+    {
+        unsigned c = rng_bounded(rng, DECK_SIZE);
+        if (used & cardset_from_num(c)) continue;
+        used |= cardset_from_num(c);
+        add_card_to(hand, card_from_num(c));
+    }
+    return hand;
+}
+
+static void hand_to_string(deck_t *hand, char *buf)
+{
+    for (size_t i = 0; i < hand->n_cards; ++i)
+    {
+        *buf++ = value_letter(*hand->cards[i]);
+        *buf++ = suit_letter(*hand->cards[i]);
+        *buf++ = i + 1 < hand->n_cards ? ' ' : '\0';
+    }
+}
+
+static void bench_evaluation(deck_t **hands, unsigned long long reps)
+{
+    unsigned long long acc = 0;
+    for (size_t i = 0; i < N_HANDS; ++i)
+    {
+        sort_hand(hands[i]);
+    }
+
+    bench_start();
+    for (unsigned long long r = 0; r < reps; ++r)
+    {
+        for (size_t i = 0; i < N_HANDS; ++i)
+        {
+            acc += evaluate_hand(hands[i]).ranking;
+        }
+    }
+    bench_stop("evaluate_hand", reps * N_HANDS);
+
+    bench_start();
+    for (unsigned long long r = 0; r < reps; ++r)
+    {
+        for (size_t i = 0; i + 1 < N_HANDS; i += 2)
+        {
+            acc += compare_hands(hands[i], hands[i + 1]) > 0;
+        }
+    }
+    bench_stop("compare_hands", reps * (N_HANDS / 2));
+
+    bench_start();
+    for (unsigned long long r = 0; r < reps; ++r)
+    {
+        for (size_t i = 0; i < N_HANDS; ++i)
+        {
+            unsigned *counts = get_match_counts(hands[i]);
+            acc += counts[0];
+            free(counts);
+        }
+    }
+    bench_stop("get_match_counts", reps * N_HANDS);
+
+    bench_start();
+    for (unsigned long long r = 0; r < reps; ++r)
+    {
+        for (size_t i = 0; i < N_HANDS; ++i)
+        {
+            acc += hand_strength(hands[i]);
+        }
+    }
+    bench_stop("hand_strength", reps * N_HANDS);
+
+    cardset_t sets[N_HANDS];
+    hand_strength_t strengths[N_HANDS];
+    for (size_t i = 0; i < N_HANDS; ++i)
+    {
+        sets[i] = cardset_from_deck(hands[i]);
+    }
+    bench_start();
+    for (unsigned long long r = 0; r < reps; ++r)
+    {
+        cardset_strengths(sets, N_HANDS, strengths);
+        acc += strengths[r % N_HANDS];
+    }
+    bench_stop("cardset_strengths", reps * N_HANDS);
+
+    uint16_t suit_masks[NUM_SUITS][N_HANDS];
+    const uint16_t *suits[NUM_SUITS];
+    for (int s = 0; s < NUM_SUITS; ++s)
+    {
+        for (size_t i = 0; i < N_HANDS; ++i)
+        {
+            suit_masks[s][i] = cardset_suit(sets[i], s);
+        }
+        suits[s] = suit_masks[s];
+    }
+    bench_start();
+    for (unsigned long long r = 0; r < reps; ++r)
+    {
+        suit_mask_strengths(suits, N_HANDS, strengths);
+        acc += strengths[r % N_HANDS];
+    }
+    bench_stop("suit_mask_strengths", reps * N_HANDS);
+    sink = acc;
+}
+
+static void bench_deck(deck_t **hands, rng_t *rng, unsigned long long reps)
+{
+    unsigned long long acc = 0;
+    deck_t *deck = generate_new_deck();
+    srand(CORPUS_SEED);
+
+    bench_start();
+    for (unsigned long long r = 0; r < reps * 64; ++r)
+    {
+        shuffle(deck);
+        acc += deck->cards[0]->value;
+    }
+    bench_stop("shuffle", reps * 64);
+
+    bench_start();
+    for (unsigned long long r = 0; r < reps * 64; ++r)
+    {
+        partial_shuffle(deck, 5, rng);
+        acc += deck->cards[0]->value;
+    }
+    bench_stop("partial_shuffle(5)", reps * 64);
+    free_deck(deck);
+
+    bench_start();
+    for (unsigned long long r = 0; r < reps * 4; ++r)
+    {
+        deck_t *remaining = build_remaining_deck(&hands[(r * 2) % N_HANDS], 2);
+        acc += remaining->n_cards;
+        free_deck(remaining);
+    }
+    bench_stop("build_remaining_deck", reps * 4);
+    sink = acc;
+}
+
+static void bench_input(deck_t **hands, unsigned long long reps)
+{
+    unsigned long long acc = 0;
+    char line[3 * DECK_SIZE];
+    size_t n_lines = N_HANDS / 4;
+    size_t text_size = n_lines * 3 * 7 + 1;
+    char *text = malloc(text_size);
+    char *p = text;
+    for (size_t i = 0; i < n_lines; ++i)
+    {
+        hand_to_string(hands[i], p);
+        p += strlen(p);
+        *p++ = '\n';
+    }
+    *p = '\0';
+
+    future_cards_t *fc = init_future_cards();
+    bench_start();
+    for (unsigned long long r = 0; r < reps; ++r)
+    {
+        for (size_t i = 0; i < n_lines; ++i)
+        {
+            hand_to_string(hands[i], line);
+            deck_t *hand = hand_from_string(line, fc);
+            acc += hand->n_cards;
+            free_deck(hand);
+        }
+    }
+    bench_stop("hand_from_string", reps * n_lines);
+    free_future_cards(fc);
+
+    bench_start();
+    for (unsigned long long r = 0; r < reps; ++r)
+    {
+        FILE *f = fmemopen(text, strlen(text), "r");
+        fc = init_future_cards();
+        size_t n_hands = 0;
+        deck_t **read = read_input(f, &n_hands, fc);
+        acc += n_hands;
+        free_decks(read, n_hands);
+        free_future_cards(fc);
+        fclose(f);
+    }
+    bench_stop("read_input (per line)", reps * n_lines);
+    free(text);
+    sink = acc;
+}
+
+static void bench_trials(unsigned long long reps)
+{
+    static const char *scenario = "As Ah ?0 ?1 ?2 ?3 ?4\nKs Kd ?0 ?1 ?2 ?3 ?4\n7c 8c ?0 ?1 ?2 ?3 ?4\n";
+    FILE *f = fmemopen((void *) scenario, strlen(scenario), "r");
+    future_cards_t *fc = init_future_cards();
+    size_t n_hands = 0;
+    deck_t **hands = read_input(f, &n_hands, fc);
+    fclose(f);
+    unsigned long long n_trials = reps * 4096;
+
+    bench_start();
+    sim_result_t *res = run_simulation(hands, n_hands, fc, n_trials, 1, CORPUS_SEED);
+    bench_stop("simulation trial", n_trials);
+    sink = res != NULL ? res->wins[0] : 0;
+    free_sim_result(res);
+    free_decks(hands, n_hands);
+    free_future_cards(fc);
+}
+
+int main(int argc, char **argv)
+{
+    unsigned long long reps = 100;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:")) != -1)
+    {
+        if (opt == 'n')
+        {
+            reps = strtoull(optarg, NULL, 10);
+        }
+        else
+        {
+            fprintf(stderr, "Usage: %s [-n repetitions]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (reps == 0) reps = 1;
+
+    rng_t rng;
+    rng_seed(&rng, CORPUS_SEED);
+    deck_t *hands[N_HANDS];
+    for (size_t i = 0; i < N_HANDS; ++i)
+    {
+        hands[i] = random_hand(&rng, 7);
+    }
+
+    init_strength_tables();
+    printf("Evaluation kernels: %s\n", strength_kernels_name());
+    printf("%-24s %12s %12s %14s %10s\n", "benchmark", "ops", "ns/op", "ops/sec", "allocs/op");
+    bench_evaluation(hands, reps);
+    bench_deck(hands, &rng, reps);
+    bench_input(hands, reps);
+    bench_trials(reps);
+
+    for (size_t i = 0; i < N_HANDS; ++i)
+    {
+        free_deck(hands[i]);
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,485 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "cache.h"
+#include "suitperm.h"
+
+/* On-disk layout. Every record starts at a multiple of 8 bytes from the
+ * start of the file, so the counts can be read in place from the mapping.
+ */
+struct cache_header_tag {
+  char magic[8];
+  uint32_t version;
+  uint32_t reserved;
+};
+typedef struct cache_header_tag cache_header_t;
+
+struct cache_record_tag {
+  uint32_t key_len;
+  uint32_t n_hands;
+  uint32_t exact;
+  uint32_t reserved;
+  uint64_t n_trials;
+  /* the key, padded to a multiple of 8 bytes, then the wins and the ties
+     split 2 to n_hands ways of every hand in canonical order */
+};
+typedef struct cache_record_tag cache_record_t;
+
+struct cache_slot_tag {
+  uint64_t hash;
+  const cache_record_t *record;   /* NULL if the slot is free */
+};
+typedef struct cache_slot_tag cache_slot_t;
+
+#define CACHE_MIN_SLOTS 64
+
+static size_t pad8(size_t n)
+{
+  return (n + 7) & ~(size_t) 7;
+}
+
+static size_t record_size(size_t key_len, size_t n_hands)
+{
+  return sizeof(cache_record_t) + pad8(key_len) + n_hands * n_hands * sizeof(uint64_t);
+}
+
+static const unsigned char *record_key(const cache_record_t *rec)
+{
+  return (const unsigned char *) (rec + 1);
+}
+
+static const uint64_t *record_counts(const cache_record_t *rec)
+{
+  return (const uint64_t *) (record_key(rec) + pad8(rec->key_len));
+}
+
+static uint64_t hash_key(const unsigned char *key, size_t len)
+/* FNV-1a. */
+{
+  uint64_t h = 0xcbf29ce484222325ULL;
+  for (size_t i = 0; i < len; ++i)
+  {
+    h = (h ^ key[i]) * 0x100000001b3ULL;
+  }
+  return h;
+}
+
+static int hand_before(scenario_t *sc, const cardset_t *known, size_t h1, size_t h2)
+{
+  if (known[h1] != known[h2]) return known[h1] < known[h2];
+  size_t n1 = 0;
+  size_t n2 = 0;
+  for (size_t s = 0; s < sc->n_slots; ++s)
+  {
+    n1 += scenario_uses(sc, h1, s);
+    n2 += scenario_uses(sc, h2, s);
+  }
+  return n1 < n2;
+}
+
+static int slot_before(scenario_t *sc, const size_t *order, size_t s1, size_t s2)
+/* Orders unknown cards by which hands hold them, those held by earlier
+ * hands (in canonical order) first.
+ */
+{
+  for (size_t i = 0; i < sc->n_hands; ++i)
+  {
+    int u1 = scenario_uses(sc, order[i], s1);
+    int u2 = scenario_uses(sc, order[i], s2);
+    if (u1 != u2) return u1;
+  }
+  return 0;
+}
+
+static unsigned char *make_key(scenario_t *sc, const cardset_t *known, size_t *order, size_t *len)
+/* Builds the key of sc, with known in place of its known cards, into a new
+ * buffer, and fills in order so that order[i] is the hand at canonical
+ * position i. Hands are sorted by their known cards and how many unknown
+ * cards they hold; unknown cards are then numbered by which of the sorted
+ * hands hold them. Unknown cards held by the same hands are
+ * interchangeable, so their numbering does not matter. Returns NULL on
+ * error, or if sc has too many unknown cards.
+ */
+{
+  size_t slots[DECK_SIZE];
+  size_t n_used = 0;
+  for (size_t s = 0; s < sc->n_slots; ++s)
+  {
+    if (!slot_is_used(sc, s)) continue;
+    if (n_used == DECK_SIZE) return NULL;
+    slots[n_used++] = s;
+  }
+  for (size_t i = 0; i < sc->n_hands; ++i)
+  {
+    size_t h = i;
+    size_t j = i;
+    while (j > 0 && hand_before(sc, known, h, order[j - 1]))
+    {
+      order[j] = order[j - 1];
+      --j;
+    }
+    order[j] = h;
+  }
+  for (size_t i = 1; i < n_used; ++i)
+  {
+    size_t s = slots[i];
+    size_t j = i;
+    while (j > 0 && slot_before(sc, order, s, slots[j - 1]))
+    {
+      slots[j] = slots[j - 1];
+      --j;
+    }
+    slots[j] = s;
+  }
+
+  uint32_t n_hands = sc->n_hands;
+  *len = sizeof(n_hands) + 1 + sc->n_hands * (sizeof(cardset_t) + 1 + n_used);
+  unsigned char *key = malloc(*len);
+  if (key == NULL)
+  {
+    fprintf(stderr, "Failed to allocate memory for cache key. Error: %d\n", errno);
+    return NULL;
+  }
+  unsigned char *p = key;
+  memcpy(p, &n_hands, sizeof(n_hands));
+  p += sizeof(n_hands);
+  *p++ = n_used;
+  for (size_t i = 0; i < sc->n_hands; ++i)
+  {
+    memcpy(p, &known[order[i]], sizeof(cardset_t));
+    p += sizeof(cardset_t);
+    unsigned char *count = p++;
+    *count = 0;
+    for (size_t k = 0; k < n_used; ++k)
+    {
+      if (scenario_uses(sc, order[i], slots[k]))
+      {
+        *p++ = k;
+        ++*count;
+      }
+    }
+  }
+  *len = p - key;
+  return key;
+}
+
+static unsigned char *canonical_key(scenario_t *sc, size_t *order, size_t *len)
+/* Builds the smallest key of sc under the 24 relabellings of the suits, so
+ * that scenarios equal up to suit share a key, and the order that goes
+ * with it. Returns NULL on error.
+ */
+{
+  cardset_t *known = malloc(sizeof(*known) * (sc->n_hands + 1));
+  size_t *try_order = malloc(sizeof(*try_order) * (sc->n_hands + 1));
+  unsigned char *best = NULL;
+  if (known == NULL || try_order == NULL)
+  {
+    fprintf(stderr, "Failed to allocate memory for cache key. Error: %d\n", errno);
+    free(known);
+    free(try_order);
+    return NULL;
+  }
+  for (unsigned p = 0; p < N_SUIT_PERMS; ++p)
+  {
+    for (size_t h = 0; h < sc->n_hands; ++h)
+    {
+      known[h] = permute_suits(sc->known[h], p);
+    }
+    size_t try_len;
+    unsigned char *key = make_key(sc, known, try_order, &try_len);
+    if (key == NULL) break;
+    if (best == NULL || memcmp(key, best, try_len) < 0)
+    {
+      free(best);
+      best = key;
+      *len = try_len;
+      memcpy(order, try_order, sizeof(*order) * sc->n_hands);
+    }
+    else
+    {
+      free(key);
+    }
+  }
+  free(known);
+  free(try_order);
+  return best;
+}
+
+static cache_slot_t *find_slot(result_cache_t *cache, uint64_t hash,
+                               const unsigned char *key, size_t len)
+/* Returns the slot holding key, or the free slot where it belongs. */
+{
+  size_t mask = cache->n_slots - 1;
+  for (size_t i = hash & mask; ; i = (i + 1) & mask)
+  {
+    cache_slot_t *slot = &cache->slots[i];
+    if (slot->record == NULL) return slot;
+    if (slot->hash == hash && slot->record->key_len == len &&
+        memcmp(record_key(slot->record), key, len) == 0)
+    {
+      return slot;
+    }
+  }
+}
+
+static int grow_slots(result_cache_t *cache)
+{
+  size_t n_slots = cache->n_slots ? 2 * cache->n_slots : CACHE_MIN_SLOTS;
+  cache_slot_t *old = cache->slots;
+  size_t n_old = cache->n_slots;
+  cache->slots = calloc(n_slots, sizeof(*cache->slots));
+  if (cache->slots == NULL)
+  {
+    fprintf(stderr, "Failed to allocate memory for cache. Error: %d\n", errno);
+    cache->slots = old;
+    return -1;
+  }
+  cache->n_slots = n_slots;
+  for (size_t i = 0; i < n_old; ++i)
+  {
+    if (old[i].record == NULL) continue;
+    *find_slot(cache, old[i].hash, record_key(old[i].record), old[i].record->key_len) = old[i];
+  }
+  free(old);
+  return 0;
+}
+
+static int insert_record(result_cache_t *cache, const cache_record_t *rec)
+{
+  if (4 * (cache->n_entries + 1) > 3 * cache->n_slots && grow_slots(cache) != 0)
+  {
+    return -1;
+  }
+  uint64_t hash = hash_key(record_key(rec), rec->key_len);
+  cache_slot_t *slot = find_slot(cache, hash, record_key(rec), rec->key_len);
+  if (slot->record == NULL) ++cache->n_entries;
+  slot->hash = hash;
+  slot->record = rec;
+  return 0;
+}
+
+static int load_records(result_cache_t *cache, const char *path)
+/* Maps the file and indexes its records. A record cut short (by a writer
+ * that died mid-append) ends the file: it is truncated away so that later
+ * appends stay aligned. Returns 0 on success.
+ */
+{
+  struct stat st;
+  if (fstat(cache->fd, &st) != 0)
+  {
+    fprintf(stderr, "Failed to read cache '%s'. Error: %d\n", path, errno);
+    return -1;
+  }
+  if (st.st_size == 0)
+  {
+    cache_header_t header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CACHE_MAGIC, sizeof(header.magic));
+    header.version = CACHE_VERSION;
+    if (write(cache->fd, &header, sizeof(header)) != sizeof(header))
+    {
+      fprintf(stderr, "Failed to write cache '%s'. Error: %d\n", path, errno);
+      return -1;
+    }
+    return 0;
+  }
+  size_t size = st.st_size;
+  cache->map = mmap(NULL, size, PROT_READ, MAP_SHARED, cache->fd, 0);
+  if (cache->map == MAP_FAILED)
+  {
+    cache->map = NULL;
+    fprintf(stderr, "Failed to map cache '%s'. Error: %d\n", path, errno);
+    return -1;
+  }
+  cache->map_size = size;
+  const cache_header_t *header = cache->map;
+  if (size < sizeof(*header) || memcmp(header->magic, CACHE_MAGIC, sizeof(header->magic)) != 0 ||
+      header->version != CACHE_VERSION)
+  {
+    fprintf(stderr, "'%s' is not a result cache of version %d.\n", path, CACHE_VERSION);
+    return -1;
+  }
+  size_t offset = sizeof(*header);
+  while (offset + sizeof(cache_record_t) <= size)
+  {
+    const cache_record_t *rec = (const cache_record_t *) ((const char *) cache->map + offset);
+    size_t n = record_size(rec->key_len, rec->n_hands);
+    if (rec->key_len == 0 || rec->n_hands == 0 || n > size - offset) break;
+    if (insert_record(cache, rec) != 0) return -1;
+    offset += n;
+  }
+  if (offset != size)
+  {
+    fprintf(stderr, "Dropping %zu bytes of incomplete record from cache '%s'.\n",
+            size - offset, path);
+    if (ftruncate(cache->fd, offset) != 0)
+    {
+      fprintf(stderr, "Failed to truncate cache '%s'. Error: %d\n", path, errno);
+      return -1;
+    }
+  }
+  return 0;
+}
+
+result_cache_t *open_result_cache(const char *path)
+/* Opens the cache file at path, creating it if needed. Returns NULL on
+ * error, including when path exists but is not a cache file.
+ */
+{
+  result_cache_t *cache = calloc(1, sizeof(*cache));
+  if (cache == NULL)
+  {
+    fprintf(stderr, "Failed to allocate memory for cache. Error: %d\n", errno);
+    return NULL;
+  }
+  cache->fd = open(path, O_RDWR | O_CREAT | O_APPEND, 0644);
+  if (cache->fd < 0)
+  {
+    fprintf(stderr, "Failed to open cache '%s'. Error: %d\n", path, errno);
+    free(cache);
+    return NULL;
+  }
+  cache->arena = init_arena(0);
+  if (cache->arena == NULL || grow_slots(cache) != 0 || load_records(cache, path) != 0)
+  {
+    close_result_cache(cache);
+    return NULL;
+  }
+  return cache;
+}
+
+static sim_result_t *result_from_record(const cache_record_t *rec, const size_t *order)
+{
+  sim_result_t *res = init_sim_result(rec->n_hands);
+  if (res == NULL) return NULL;
+  const uint64_t *counts = record_counts(rec);
+  res->n_trials = rec->n_trials;
+  res->exact = rec->exact;
+  size_t n = rec->n_hands;
+  for (size_t i = 0; i < n; ++i)
+  {
+    const uint64_t *c = counts + n * i;
+    res->wins[order[i]] = c[0];
+    for (size_t k = 2; k <= n; ++k)
+    {
+      res->ties[order[i]] += c[k - 1];
+      res->split_ties[split_index(n, order[i], k)] = c[k - 1];
+    }
+  }
+  return res;
+}
+
+sim_result_t *cache_lookup(result_cache_t *cache, scenario_t *sc, int need_exact,
+                           unsigned long long min_trials, double tolerance)
+/* Returns a new result for sc, with the hands in sc's order, if the cache
+ * holds one that is good enough (see sim_result_suffices), and NULL
+ * otherwise. Counts the lookup as a hit or a miss. Scenarios with ranges
+ * are not cached, as the key does not describe the ranges.
+ */
+{
+  if (scenario_has_ranges(sc)) return NULL;
+  size_t *order = malloc(sizeof(*order) * (sc->n_hands + 1));
+  size_t len;
+  unsigned char *key = order != NULL ? canonical_key(sc, order, &len) : NULL;
+  sim_result_t *res = NULL;
+  if (key != NULL)
+  {
+    cache_slot_t *slot = find_slot(cache, hash_key(key, len), key, len);
+    if (slot->record != NULL)
+    {
+      res = result_from_record(slot->record, order);
+    }
+  }
+  if (res != NULL && !sim_result_suffices(res, need_exact, min_trials, tolerance))
+  {
+    free_sim_result(res);
+    res = NULL;
+  }
+  if (res != NULL)
+  {
+    ++cache->hits;
+  }
+  else
+  {
+    ++cache->misses;
+  }
+  free(key);
+  free(order);
+  return res;
+}
+
+int cache_store(result_cache_t *cache, scenario_t *sc, sim_result_t *res)
+/* Appends res, computed for sc, to the cache file and the in-memory index.
+ * Returns 0 on success (or if sc has ranges, which are not cached) and -1
+ * on error.
+ */
+{
+  if (scenario_has_ranges(sc)) return 0;
+  size_t *order = malloc(sizeof(*order) * (sc->n_hands + 1));
+  size_t len;
+  unsigned char *key = order != NULL ? canonical_key(sc, order, &len) : NULL;
+  if (key == NULL || sc->n_hands == 0 || res->n_hands != sc->n_hands)
+  {
+    free(key);
+    free(order);
+    return -1;
+  }
+  size_t n = record_size(len, sc->n_hands);
+  cache_record_t *rec = arena_alloc(cache->arena, n);
+  int status = -1;
+  if (rec != NULL)
+  {
+    memset(rec, 0, n);
+    rec->key_len = len;
+    rec->n_hands = sc->n_hands;
+    rec->exact = res->exact;
+    rec->n_trials = res->n_trials;
+    memcpy(rec + 1, key, len);
+    uint64_t *counts = (uint64_t *) record_counts(rec);
+    size_t n_hands = sc->n_hands;
+    for (size_t i = 0; i < n_hands; ++i)
+    {
+      uint64_t *c = counts + n_hands * i;
+      c[0] = res->wins[order[i]];
+      for (size_t k = 2; k <= n_hands; ++k)
+      {
+        c[k - 1] = res->split_ties[split_index(n_hands, order[i], k)];
+      }
+    }
+    /* One write per record: appends from several processes do not
+       interleave. */
+    if (write(cache->fd, rec, n) != (ssize_t) n)
+    {
+      fprintf(stderr, "Failed to append to cache. Error: %d\n", errno);
+    }
+    else if (insert_record(cache, rec) == 0)
+    {
+      ++cache->stores;
+      status = 0;
+    }
+  }
+  free(key);
+  free(order);
+  return status;
+}
+
+void print_cache_stats(result_cache_t *cache, FILE *f)
+{
+  fprintf(f, "Cache: %llu hits, %llu misses, %llu stored, %zu entries\n",
+          cache->hits, cache->misses, cache->stores, cache->n_entries);
+}
+
+void close_result_cache(result_cache_t *cache)
+{
+  if (cache == NULL) return;
+  if (cache->map != NULL) munmap(cache->map, cache->map_size);
+  if (cache->fd >= 0) close(cache->fd);
+  free(cache->slots);
+  free_arena(cache->arena);
+  free(cache);
+}
@@ -0,0 +1,46 @@
+#ifndef CACHE_H
+#define CACHE_H
+#include <stdint.h>
+#include <stdio.h>
+#include "arena.h"
+#include "scenario.h"
+#include "sim.h"
+
+/* A persistent cache of equity results, keyed by a canonical encoding of a
+ * scenario: the known cards of each hand as a card set and the unknown
+ * cards renumbered by which hands hold them, with the hands in a canonical
+ * order and the suits relabelled to give the smallest key. Inputs that
+ * differ only in card order, hand order, whitespace, ?n numbering or a
+ * permutation of the suits share one entry.
+ *
+ * The cache file is a header followed by appended records. It is mapped
+ * read-only when opened, and new results are appended to it with a single
+ * write each; a later record for a key replaces earlier ones. Records use
+ * the host's byte order, so a cache file is not portable between machines
+ * of different endianness.
+ */
+struct cache_slot_tag;
+struct result_cache_tag {
+  int fd;
+  void *map;                      /* the file as it was when opened */
+  size_t map_size;
+  struct cache_slot_tag *slots;   /* open-addressed table of records */
+  size_t n_slots;
+  size_t n_entries;
+  arena_t *arena;                 /* records added since the file was opened */
+  unsigned long long hits;
+  unsigned long long misses;
+  unsigned long long stores;
+};
+typedef struct result_cache_tag result_cache_t;
+
+#define CACHE_MAGIC "PKRCACHE"
+#define CACHE_VERSION 4
+
+result_cache_t *open_result_cache(const char *path);
+sim_result_t *cache_lookup(result_cache_t *cache, scenario_t *sc, int need_exact,
+                           unsigned long long min_trials, double tolerance);
+int cache_store(result_cache_t *cache, scenario_t *sc, sim_result_t *res);
+void print_cache_stats(result_cache_t *cache, FILE *f);
+void close_result_cache(result_cache_t *cache);
+#endif
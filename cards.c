@@ -76,7 +76,11 @@ char suit_letter(card_t c) {
 }
 
 void print_card(card_t c) {
-	printf("%c%c", value_letter(c), suit_letter(c));
+	fprint_card(stdout, c);
+}
+
+void fprint_card(FILE *f, card_t c) {
+	fprintf(f, "%c%c", value_letter(c), suit_letter(c));
 }
 
 int value_to_int(char letter)
@@ -131,3 +135,8 @@ card_t card_from_num(unsigned c) {
   assert_card_valid(temp);
   return temp;
 }
+
+unsigned card_to_num(card_t c) {
+  /* The inverse of card_from_num. */
+  return c.suit * 13 + c.value - 2;
+}
@@ -1,5 +1,6 @@
 #ifndef CARD_H
 #define CARD_H
+#include <stdio.h>
 #define VALUE_ACE 14
 #define VALUE_KING 13
 #define VALUE_QUEEN 12
@@ -29,11 +30,13 @@ typedef enum {
   NOTHING
 } hand_ranking_t;
 card_t card_from_num(unsigned c);
+unsigned card_to_num(card_t c);
 int is_card_valid(card_t card);
 void assert_card_valid(card_t c);
 const char * ranking_to_string(hand_ranking_t r) ;
 char value_letter(card_t c);
 char suit_letter(card_t c) ;
 void print_card(card_t c);
+void fprint_card(FILE *f, card_t c);
 card_t card_from_letters(char value_let, char suit_let);
 #endif
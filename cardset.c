@@ -0,0 +1,79 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "cardset.h"
+
+cardset_t cardset_from_deck(deck_t * deck)
+/* Returns the set of cards in the deck. Placeholder cards for unknown cards
+ * (see add_empty_card) are not valid cards and are skipped.
+ */
+{
+  cardset_t set = CARDSET_EMPTY;
+  for (size_t i = 0; i < deck->n_cards; ++i)
+  {
+    if (is_card_valid(*deck->cards[i]))
+    {
+      set = cardset_add(set, *deck->cards[i]);
+    }
+  }
+  return set;
+}
+
+cardset_t cardset_from_hands(deck_t ** hands, size_t n_hands)
+/* Returns the union of the known cards of all the hands. */
+{
+  cardset_t set = CARDSET_EMPTY;
+  for (size_t i = 0; i < n_hands; ++i)
+  {
+    set |= cardset_from_deck(hands[i]);
+  }
+  return set;
+}
+
+deck_t * deck_from_cardset(cardset_t set)
+{
+  return deck_from_cardset_in(set, NULL);
+}
+
+deck_t * deck_from_cardset_in(cardset_t set, arena_t *arena)
+/* Builds a deck holding every card in set, ordered by card number (the same
+ * order as card_from_num), allocated from arena or with malloc if arena is
+ * NULL. The pointer array is allocated once, with room for every card
+ * (deck_reserve rounds its capacity up to a power of two, at least 8).
+ */
+{
+  deck_t *deck = initialize_deck_in(arena);
+  if (deck == NULL)
+  {
+    return NULL;
+  }
+  if (deck_reserve(deck, cardset_size(set)) != 0)
+  {
+    free_deck(deck);
+    return NULL;
+  }
+  while (set != CARDSET_EMPTY)
+  {
+    card_t *card = deck_alloc_card(deck);
+    if (card == NULL)
+    {
+      free_deck(deck);
+      return NULL;
+    }
+    *card = card_from_num(__builtin_ctzll(set));
+    deck->cards[deck->n_cards++] = card;
+    set &= set - 1;
+  }
+  return deck;
+}
+
+void print_cardset(cardset_t set)
+{
+  int first = 1;
+  while (set != CARDSET_EMPTY)
+  {
+    if (!first) printf(" ");
+    print_card(card_from_num(__builtin_ctzll(set)));
+    first = 0;
+    set &= set - 1;
+  }
+}
@@ -0,0 +1,71 @@
+#ifndef CARDSET_H
+#define CARDSET_H
+#include <stdint.h>
+#include "cards.h"
+#include "deck.h"
+
+/* A set of distinct cards packed into a single 64-bit word. Bit i is set when
+ * card_from_num(i) is in the set, so each suit occupies its own contiguous
+ * 13-bit field of ranks (bit 0 of the field is a two, bit 12 an ace).
+ *
+ * The small operations are static inline so that set arithmetic compiles down
+ * to a handful of word instructions at the call site.
+ */
+typedef uint64_t cardset_t;
+
+#define CARDSET_EMPTY ((cardset_t) 0)
+#define CARDSET_FULL ((((cardset_t) 1) << DECK_SIZE) - 1)
+#define RANK_MASK_ALL 0x1fffu
+
+static inline cardset_t cardset_from_num(unsigned c)
+{
+  return ((cardset_t) 1) << c;
+}
+
+static inline cardset_t cardset_from_card(card_t c)
+{
+  return cardset_from_num(card_to_num(c));
+}
+
+static inline int cardset_contains(cardset_t set, card_t c)
+{
+  return (set & cardset_from_card(c)) != 0;
+}
+
+static inline cardset_t cardset_add(cardset_t set, card_t c)
+{
+  return set | cardset_from_card(c);
+}
+
+static inline unsigned cardset_size(cardset_t set)
+{
+  return __builtin_popcountll(set);
+}
+
+static inline cardset_t cardset_complement(cardset_t set)
+{
+  return ~set & CARDSET_FULL;
+}
+
+static inline unsigned cardset_suit(cardset_t set, suit_t suit)
+/* Returns the 13-bit rank mask of the cards of the given suit. */
+{
+  return (unsigned) (set >> (13 * suit)) & RANK_MASK_ALL;
+}
+
+static inline suit_t cardset_flush_suit(cardset_t set)
+/* Returns the first suit with at least five cards in set, or NUM_SUITS. */
+{
+  for (int s = 0; s < NUM_SUITS; ++s)
+  {
+    if (__builtin_popcount(cardset_suit(set, s)) >= 5) return s;
+  }
+  return NUM_SUITS;
+}
+
+cardset_t cardset_from_deck(deck_t * deck);
+cardset_t cardset_from_hands(deck_t ** hands, size_t n_hands);
+deck_t * deck_from_cardset(cardset_t set);
+deck_t * deck_from_cardset_in(cardset_t set, arena_t *arena);
+void print_cardset(cardset_t set);
+#endif
@@ -0,0 +1,71 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "arena.h"
+#include "future.h"
+#include "input.h"
+#include "pack.h"
+
+/* Converts scenarios in the text syntax into a scenario pack, which poker
+ * loads without tokenising. Each input file is one scenario, read as poker
+ * reads an input file (blank lines are ignored), so a pack evaluates to the
+ * answers of its input files in turn.
+ */
+
+void usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s input_file... pack_file\n", prog);
+    fprintf(stderr, "  input_file  one scenario, one hand per line as poker reads it; blank\n");
+    fprintf(stderr, "              lines are ignored, so every file is a single scenario\n");
+    fprintf(stderr, "  pack_file   the scenario pack to write, of the scenarios in order\n");
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 3)
+    {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    const char *pack_path = argv[argc - 1];
+    arena_t *arena = init_arena(0);
+    pack_writer_t *w = arena != NULL ? open_pack_writer(pack_path) : NULL;
+    if (w == NULL)
+    {
+        free_arena(arena);
+        return EXIT_FAILURE;
+    }
+
+    int ok = 1;
+    size_t n_scenarios = 0;
+    size_t n_hands_total = 0;
+    for (int i = 1; i < argc - 1; ++i)
+    {
+        reset_arena(arena);
+        future_cards_t *fc = init_future_cards_in(arena);
+        size_t n_hands = 0;
+        deck_t **hands = fc != NULL ? read_input_file(argv[i], &n_hands, fc) : NULL;
+        if (hands == NULL || write_pack_scenario(w, hands, n_hands, fc) != 0)
+        {
+            fprintf(stderr, "Failed to convert '%s'.\n", argv[i]);
+            ok = 0;
+            break;
+        }
+        ++n_scenarios;
+        n_hands_total += n_hands;
+    }
+    if (close_pack_writer(w) != 0)
+    {
+        ok = 0;
+    }
+    if (ok)
+    {
+        printf("Wrote %zu scenarios of %zu hands to '%s'.\n", n_scenarios, n_hands_total,
+               pack_path);
+    }
+    else
+    {
+        remove(pack_path);
+    }
+    free_arena(arena);
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,75 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cpu.h"
+
+static const char *const level_names[NUM_CPU_LEVELS] = {
+  "scalar", "sse4.2", "avx2", "avx512"
+};
+
+static int chosen_level = -1;
+
+cpu_level_t detect_cpu_level(void)
+/* The highest level the processor (and the operating system, for the
+ * wider registers) supports, as reported by cpuid.
+ */
+{
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") &&
+      __builtin_cpu_supports("avx512dq") && __builtin_cpu_supports("avx512vl") &&
+      __builtin_cpu_supports("bmi2"))
+  {
+    return CPU_AVX512;
+  }
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("bmi2"))
+  {
+    return CPU_AVX2;
+  }
+  if (__builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("popcnt"))
+  {
+    return CPU_SSE42;
+  }
+#endif
+  return CPU_SCALAR;
+}
+
+static cpu_level_t requested_level(cpu_level_t detected)
+/* The level named by CPU_LEVEL_ENV, or detected if it names none this
+ * processor supports. Whenever the variable is set, the level used is
+ * reported on stderr, so that a run can be checked to use what it asked
+ * for.
+ */
+{
+  const char *name = getenv(CPU_LEVEL_ENV);
+  if (name == NULL || *name == '\0') return detected;
+  for (int level = 0; level < NUM_CPU_LEVELS; ++level)
+  {
+    if (strcmp(name, level_names[level]) != 0) continue;
+    if (level > detected)
+    {
+      fprintf(stderr, "This processor does not support the %s kernels; using %s.\n",
+              name, level_names[detected]);
+      return detected;
+    }
+    fprintf(stderr, "Using the %s kernels, as %s asks.\n", name, CPU_LEVEL_ENV);
+    return level;
+  }
+  fprintf(stderr, "Unknown kernels '%s' in %s; using %s.\n", name, CPU_LEVEL_ENV,
+          level_names[detected]);
+  return detected;
+}
+
+cpu_level_t cpu_level(void)
+/* The level the evaluation kernels use. It is chosen on the first call,
+ * which must happen before other threads make any.
+ */
+{
+  if (chosen_level < 0) chosen_level = requested_level(detect_cpu_level());
+  return chosen_level;
+}
+
+const char *cpu_level_name(cpu_level_t level)
+{
+  return level < NUM_CPU_LEVELS ? level_names[level] : "unknown";
+}
@@ -0,0 +1,22 @@
+#ifndef CPU_H
+#define CPU_H
+
+/* Instruction set levels that have their own evaluation kernels, from the
+ * portable one up. The level used is the highest the processor supports,
+ * picked once, unless the environment variable CPU_LEVEL_ENV names another
+ * supported one (e.g. POKER_KERNELS=scalar, for testing).
+ */
+typedef enum {
+  CPU_SCALAR,   /* plain C, one hand at a time */
+  CPU_SSE42,    /* SSE4.2 and POPCNT, 4 hands per vector */
+  CPU_AVX2,     /* AVX2 and BMI2, 8 hands per vector */
+  CPU_AVX512,   /* AVX-512 F, BW, DQ and VL, 16 hands per vector */
+  NUM_CPU_LEVELS
+} cpu_level_t;
+
+#define CPU_LEVEL_ENV "POKER_KERNELS"
+
+cpu_level_t detect_cpu_level(void);
+cpu_level_t cpu_level(void);
+const char *cpu_level_name(cpu_level_t level);
+#endif
@@ -3,6 +3,7 @@
 #include <stdlib.h>
 #include <assert.h>
 #include "deck.h"
+#include "cardset.h"
 
 int cards_equal(card_t card1, card_t card2)
 {
@@ -10,13 +11,18 @@ int cards_equal(card_t card1, card_t card2)
 }
 
 void print_hand(deck_t * hand){
+  fprint_hand(stdout, hand);
+}
+
+void fprint_hand(FILE *f, deck_t *hand)
+{
   size_t n_cards = hand->n_cards;
   size_t last = n_cards - 1;
   card_t **cards = hand->cards;
   for (int i = 0; i < n_cards; ++i)
   {
-    print_card(*cards[i]);
-    if (i < last) printf(" ");
+    fprint_card(f, *cards[i]);
+    if (i < last) fprintf(f, " ");
   }
 }
 
@@ -44,15 +50,30 @@ void shuffle(deck_t * d)
   }
 }
 
-void assert_full_deck(deck_t * d)
+void partial_shuffle(deck_t * d, size_t k, rng_t *rng)
+/* Puts a uniformly random selection of k cards, in random order, into the
+ * first k positions of d (the first k steps of a Fisher-Yates shuffle). The
+ * rest of the deck is left in some unspecified order. This is all
+ * future_cards_from_deck needs, and costs O(k) instead of O(n_cards).
+ */
 {
-  assert(d->n_cards == DECK_SIZE);
-  card_t card;
-  for (int i = 0; i < d->n_cards; ++i)
+  card_t **cards = d->cards;
+  size_t n_cards = d->n_cards;
+  card_t *temp;
+  if (k > n_cards) k = n_cards;
+  for (size_t i = 0; i < k; ++i)
   {
-    card = card_from_num(i);
-    assert(deck_contains(d, card));
+    size_t j = i + rng_bounded(rng, n_cards - i);
+    temp = cards[j];
+    cards[j] = cards[i];
+    cards[i] = temp;
   }
+}
+
+void assert_full_deck(deck_t * d)
+{
+  assert(d->n_cards == DECK_SIZE);
+  assert(cardset_from_deck(d) == CARDSET_FULL);
   printf("Full deck asserted!\n");
 }
 
@@ -77,19 +98,80 @@ void print_deck(deck_t *deck)
   printf("\n--------------------------------------\n");
 }
 
-deck_t *initialize_deck()
+void initialize_deck_struct(deck_t *deck, arena_t *arena)
+/* Sets up an empty deck in existing storage. Its cards will be allocated
+ * from arena, or with malloc if arena is NULL.
+ */
+{
+  deck->cards = NULL;
+  deck->n_cards = 0;
+  deck->capacity = 0;
+  deck->arena = arena;
+}
+
+deck_t *initialize_deck_in(arena_t *arena)
+/* Allocates an empty deck from arena (or with malloc if arena is NULL).
+ * Everything later added to an arena deck is allocated from the same arena
+ * and is released with it; free_deck leaves such decks alone.
+ */
 {
-  deck_t *deck = malloc(sizeof(*deck));
+  deck_t *deck = arena != NULL ? arena_alloc(arena, sizeof(*deck)) : malloc(sizeof(*deck));
   if (deck == NULL)
   {
     fprintf(stderr, "Failed to allocate memory for new deck. Error: %d\n", errno);
     return NULL;
   }
-  deck->n_cards = 0;
-  deck->cards = NULL;
+  initialize_deck_struct(deck, arena);
   return deck;
 }
 
+deck_t *initialize_deck()
+{
+  return initialize_deck_in(NULL);
+}
+
+card_t *deck_alloc_card(deck_t *deck)
+/* Allocates storage for one card owned by deck. */
+{
+  card_t *card = deck->arena != NULL ? arena_alloc(deck->arena, sizeof(*card)) : malloc(sizeof(*card));
+  if (card == NULL)
+  {
+    fprintf(stderr, "Could not allocate memory for a new card. Error: %d\n", errno);
+  }
+  return card;
+}
+
+int deck_reserve(deck_t *deck, size_t n)
+/* Makes room for at least n card pointers, doubling the capacity so that
+ * adding cards one at a time costs amortised O(1). Returns 0 on success.
+ */
+{
+  if (n <= deck->capacity) return 0;
+  size_t capacity = deck->capacity > 0 ? deck->capacity : 8;
+  while (capacity < n)
+  {
+    capacity *= 2;
+  }
+  card_t **cards;
+  if (deck->arena != NULL)
+  {
+    cards = arena_realloc(deck->arena, deck->cards, sizeof(*cards) * deck->n_cards,
+                          sizeof(*cards) * capacity);
+  }
+  else
+  {
+    cards = realloc(deck->cards, sizeof(*cards) * capacity);
+  }
+  if (cards == NULL)
+  {
+    fprintf(stderr, "Could not allocate memory for larger deck. Error: %d\n", errno);
+    return -1;
+  }
+  deck->cards = cards;
+  deck->capacity = capacity;
+  return 0;
+}
+
 deck_t *generate_new_deck()
 {
     deck_t *deck = initialize_deck();
@@ -104,6 +186,7 @@ deck_t *generate_new_deck()
       free(deck);
       return NULL;
     }
+    deck->capacity = DECK_SIZE;
     card_t card;
     for (int i = 0; i < DECK_SIZE; ++i)
     {
@@ -129,13 +212,10 @@ deck_t *generate_new_deck()
 
 void add_card_pointer_to_deck(deck_t *deck, card_t *p)
 {
-  card_t **cards = realloc(deck->cards, sizeof(*cards) * (deck->n_cards + 1));
-  if (cards == NULL)
+  if (deck_reserve(deck, deck->n_cards + 1) != 0)
   {
-    fprintf(stderr, "Failed to allocate memory for larger deck of card pointers. Error: %d\n", errno);
     return;
   }
-  deck->cards = cards;
   deck->cards[deck->n_cards] = p;
   ++deck->n_cards;
 }
@@ -145,22 +225,17 @@ void add_card_to(deck_t * deck, card_t c)
 /* Add the particular card to the given deck (which will
    involve reallocing the array of cards in that deck).
  */
-  card_t *new_card = malloc(sizeof(*new_card));
-  if (new_card == NULL)
+  if (deck_reserve(deck, deck->n_cards + 1) != 0)
   {
-    fprintf(stderr, "Could not allocate memory for a new card. Error: %d\n", errno);
     return;
   }
-  card_t **new_cards = realloc(deck->cards, sizeof(*new_cards) * (deck->n_cards + 1));
-  if (new_cards == NULL)
+  card_t *new_card = deck_alloc_card(deck);
+  if (new_card == NULL)
   {
-    fprintf(stderr, "Could not allocate memory for larger deck. Error: %d\n", errno);
-    free(new_card);
     return;
   }
   new_card->suit = c.suit;
   new_card->value = c.value;
-  deck->cards = new_cards;
   deck->cards[deck->n_cards] = new_card;
   ++deck->n_cards;
 }
@@ -172,27 +247,52 @@ card_t * add_empty_card(deck_t * deck)
    This will add an invalid card to use as a placeholder
    for an unknown card.
   */
-  card_t *new_card = malloc(sizeof(*new_card));
-  if (new_card == NULL)
+  if (deck_reserve(deck, deck->n_cards + 1) != 0)
   {
-    fprintf(stderr, "Could not allocate memory for a new card. Error: %d\n", errno);
     return NULL;
   }
-  card_t **new_cards = realloc(deck->cards, sizeof(*new_cards) * (deck->n_cards + 1));
-  if (new_cards == NULL)
+  card_t *new_card = deck_alloc_card(deck);
+  if (new_card == NULL)
   {
-    fprintf(stderr, "Could not allocate memory for larger deck. Error: %d\n", errno);
-    free(new_card);
     return NULL;
   }
   new_card->suit = 0;
   new_card->value = 0;
-  deck->cards = new_cards;
   deck->cards[deck->n_cards] = new_card;
   ++deck->n_cards;
   return new_card;
 }
 
+int add_empty_cards(deck_t *deck, size_t n)
+/* Adds n placeholder cards (see add_empty_card) at once, as
+ * deck->cards[deck->n_cards - n] onwards. In an arena deck they take one
+ * allocation. Returns 0 on success and -1 on error.
+ */
+{
+  if (deck_reserve(deck, deck->n_cards + n) != 0)
+  {
+    return -1;
+  }
+  card_t *block = NULL;
+  if (deck->arena != NULL && n > 0)
+  {
+    block = arena_alloc(deck->arena, sizeof(*block) * n);
+    if (block == NULL) return -1;
+  }
+  for (size_t i = 0; i < n; ++i)
+  {
+    card_t *new_card = block != NULL ? &block[i] : deck_alloc_card(deck);
+    if (new_card == NULL)
+    {
+      return -1;
+    }
+    new_card->suit = 0;
+    new_card->value = 0;
+    deck->cards[deck->n_cards++] = new_card;
+  }
+  return 0;
+}
+
 deck_t * make_deck_exclude(deck_t * excluded_cards)
 {
  /*
@@ -206,21 +306,7 @@ deck_t * make_deck_exclude(deck_t * excluded_cards)
    in Course 2 and int deck_contains(deck_t * d, card_t c)
    in Course 3!  They might be useful here.
  */
- deck_t *new_deck = initialize_deck();
- if (new_deck == NULL)
- {
-  return NULL;
- }
- card_t card;
- for (int i = 0; i < DECK_SIZE; ++i)
- {
-  card = card_from_num(i);
-  if (!deck_contains(excluded_cards, card))
-  {
-    add_card_to(new_deck, card);
-  }
- }
- return new_deck;
+ return deck_from_cardset(cardset_complement(cardset_from_deck(excluded_cards)));
 }
 
 
@@ -239,23 +325,13 @@ deck_t * build_remaining_deck(deck_t ** hands, size_t n_hands)
    (remember you just wrote add_card_to),
    and then pass it to make_deck_exclude.
 */
-  deck_t *exclude = initialize_deck();
-  if (exclude == NULL)
-  {
-    return NULL;
-  }
-  for (int i = 0; i < n_hands; ++i)
-  {
-    for (int j = 0; j < hands[i]->n_cards; ++j)
-    {
-      if (is_card_valid(*hands[i]->cards[j]))
-      {
-        print_card(*hands[i]->cards[j]);
-        add_card_to(exclude, *hands[i]->cards[j]);
-      }
-    }
-  }
-  return make_deck_exclude(exclude);
+  return build_remaining_deck_in(hands, n_hands, NULL);
+}
+
+deck_t * build_remaining_deck_in(deck_t ** hands, size_t n_hands, arena_t *arena)
+/* build_remaining_deck, allocating the new deck from arena. */
+{
+  return deck_from_cardset_in(cardset_complement(cardset_from_hands(hands, n_hands)), arena);
 }
 
 void free_deck(deck_t * deck)
@@ -268,7 +344,7 @@ void free_deck(deck_t * deck)
    Once you have written it, add calls to free_deck anywhere you
    need to to avoid memory leaks.
 */
-  if (deck == NULL) return;
+  if (deck == NULL || deck->arena != NULL) return;
   for (int i = 0; i < deck->n_cards; ++i)
   {
     free(deck->cards[i]);
@@ -278,8 +354,12 @@ void free_deck(deck_t * deck)
 }
 
 void free_decks(deck_t **decks, size_t n_decks)
+/* Frees an array of decks and the decks in it. An array of arena decks (as
+ * built by read_input into an arena) belongs to the arena and is left alone.
+ */
 {
   if (decks == NULL) return;
+  if (n_decks > 0 && decks[0]->arena != NULL) return;
   for (size_t i = 0; i < n_decks; ++i)
   {
     free_deck(decks[i]);
@@ -288,12 +368,48 @@ void free_decks(deck_t **decks, size_t n_decks)
 }
 
 void add_hand_to_deck(deck_t *deck, deck_t *hand)
+/* Appends a copy of every card in hand to deck. The pointer array is grown
+ * once for the whole hand rather than once per card.
+ */
 {
-  card_t card;
+  if (deck_reserve(deck, deck->n_cards + hand->n_cards) != 0)
+  {
+    return;
+  }
   for (size_t i = 0; i < hand->n_cards; ++i)
   {
-    card.suit = hand->cards[i]->suit;
-    card.value = hand->cards[i]->value;
-    add_card_to(deck, card);
+    card_t *new_card = deck_alloc_card(deck);
+    if (new_card == NULL)
+    {
+      return;
+    }
+    *new_card = *hand->cards[i];
+    deck->cards[deck->n_cards] = new_card;
+    ++deck->n_cards;
+  }
+}
+
+deck_t *copy_deck(deck_t *deck)
+{
+  return copy_deck_in(deck, NULL);
+}
+
+deck_t *copy_deck_in(deck_t *deck, arena_t *arena)
+/* Returns a deep copy of deck, allocated from arena (or with malloc if arena
+ * is NULL): new cards with the same values and suits (placeholders
+ * included), in the same order.
+ */
+{
+  deck_t *copy = initialize_deck_in(arena);
+  if (copy == NULL)
+  {
+    return NULL;
+  }
+  add_hand_to_deck(copy, deck);
+  if (copy->n_cards != deck->n_cards)
+  {
+    free_deck(copy);
+    return NULL;
   }
+  return copy;
 }
@@ -1,30 +1,44 @@
 #ifndef DECK_H
 #define DECK_H
 #include <stdlib.h>
+#include "arena.h"
 #include "cards.h"
+#include "rng.h"
 
 #define DECK_SIZE 52
 
 struct deck_tag {
 	  card_t ** cards;
 	    size_t n_cards;
+	    size_t capacity;   /* allocated length of cards */
+	    arena_t *arena;    /* owner of the cards, or NULL for malloc */
 };
 typedef struct deck_tag deck_t;
 
 void print_hand(deck_t * hand);
+void fprint_hand(FILE *f, deck_t *hand);
 int deck_contains(deck_t * d, card_t c) ;
 void shuffle(deck_t * d);
 void assert_full_deck(deck_t * d) ;
 //The below functions will be done in course 4.
 void print_deck(deck_t *deck);
 deck_t *initialize_deck();
+deck_t *initialize_deck_in(arena_t *arena);
+void initialize_deck_struct(deck_t *deck, arena_t *arena);
+int deck_reserve(deck_t *deck, size_t n);
+card_t *deck_alloc_card(deck_t *deck);
 deck_t *generate_new_deck();
 deck_t * make_deck_exclude(deck_t * excluded_cards);
 void add_card_to(deck_t * deck, card_t c);
 card_t * add_empty_card(deck_t * deck);
+int add_empty_cards(deck_t *deck, size_t n);
 void free_deck(deck_t * deck) ;
 deck_t * build_remaining_deck(deck_t ** hands, size_t n_hands) ;
+deck_t * build_remaining_deck_in(deck_t ** hands, size_t n_hands, arena_t *arena);
 void add_hand_to_deck(deck_t *deck, deck_t *hand);
 void add_card_pointer_to_deck(deck_t *deck, card_t *p);
 void free_decks(deck_t **decks, size_t n_decks);
+deck_t *copy_deck(deck_t *deck);
+deck_t *copy_deck_in(deck_t *deck, arena_t *arena);
+void partial_shuffle(deck_t * d, size_t k, rng_t *rng);
 #endif
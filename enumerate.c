@@ -0,0 +1,448 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "enumerate.h"
+#include "pool.h"
+#include "strength.h"
+#include "suitperm.h"
+
+/* Exact evaluation of a scenario by visiting every way of dealing the
+ * remaining deck into the unknown cards.
+ *
+ * Unknown cards held by exactly the same set of hands are interchangeable
+ * (swapping the cards dealt to ?0 and ?1 when both are on the shared board
+ * changes nothing), so the used ?n indices are grouped into classes and each
+ * class is dealt a combination rather than a permutation of cards. Every
+ * combination is an equally likely outcome, so counting wins and ties over
+ * all of them gives exact equities.
+ *
+ * Outcomes that differ only by a permutation of the suits that maps every
+ * hand's known cards onto themselves are equivalent. Each time a class has
+ * been dealt, only combinations that are the smallest of their images under
+ * the permutations still in play are followed, weighted by the number of
+ * images; the permutations that fix the combination stay in play for the
+ * next class. With no known cards this visits about one outcome in 24.
+ *
+ * Hands with ranges are dealt every combination of their ranges that shares
+ * no card with the known cards or the other hands' combinations, and the
+ * unknown cards are enumerated for each such deal, weighted by the product
+ * of the combinations' weights (each range's weights divided by their
+ * greatest common divisor, so that ranges without weights count every
+ * outcome once). The suit symmetry is then that of the known cards and the
+ * dealt combinations together.
+ *
+ * The cards every hand holds (the board) are put together once per outcome
+ * and each hand then only adds its own cards. The hands of ENUM_EVAL_LEAVES
+ * outcomes are evaluated together, each whole, by cardset_strengths before
+ * their showdowns are counted.
+ *
+ * The combinations dealt to the first class (or, if there are no unknown
+ * cards, the deals of the ranges) are numbered in the order they are
+ * visited; thread i of n handles those whose number is i modulo n, and
+ * enumerates everything below them.
+ */
+struct enum_plan_tag {
+  scenario_t *sc;
+  size_t n_classes;
+  size_t class_size[DECK_SIZE];
+  unsigned char *member;   /* member[h * n_classes + c]: hand h holds class c */
+  unsigned char shared[DECK_SIZE];  /* every hand holds class c */
+  cardset_t board_known;   /* known cards every hand holds */
+  unsigned *weight_unit;   /* gcd of the weights of hand h's range, or 0 */
+  double n_deals;          /* at most this many deals of the ranges */
+  size_t n_hole_cards;     /* dealt from the ranges */
+  unsigned char remaining[DECK_SIZE];
+  size_t n_remaining;
+};
+typedef struct enum_plan_tag enum_plan_t;
+
+#define ENUM_EVAL_LEAVES 16
+
+struct enum_worker_tag {
+  enum_plan_t *plan;
+  unsigned index;
+  unsigned n_threads;
+  unsigned long long counter;
+  cardset_t *own;          /* [h]: hand h's cards off the board; [n_hands]: the board's */
+  cardset_t class_cards[DECK_SIZE];
+  suit_group_t group[DECK_SIZE + 1];         /* permutations in play at class c */
+  unsigned long long weight[DECK_SIZE + 1];  /* outcomes per visit at class c */
+  cardset_t *sets;                 /* [leaf * n_hands + h]: the pending outcomes' hands */
+  hand_strength_t *strengths;      /* their strengths, likewise */
+  unsigned long long pending_weight[ENUM_EVAL_LEAVES];
+  size_t n_pending;                /* outcomes dealt but not yet counted */
+  sim_result_t *res;
+};
+typedef struct enum_worker_tag enum_worker_t;
+
+static int same_holders(scenario_t *sc, size_t s1, size_t s2)
+{
+  for (size_t h = 0; h < sc->n_hands; ++h)
+  {
+    if (scenario_uses(sc, h, s1) != scenario_uses(sc, h, s2)) return 0;
+  }
+  return 1;
+}
+
+static void free_enum_plan(enum_plan_t *plan)
+{
+  if (plan == NULL) return;
+  free(plan->member);
+  free(plan->weight_unit);
+  free(plan);
+}
+
+static unsigned gcd(unsigned a, unsigned b)
+{
+  while (b != 0)
+  {
+    unsigned r = a % b;
+    a = b;
+    b = r;
+  }
+  return a;
+}
+
+static int add_plan_ranges(enum_plan_t *plan, scenario_t *sc)
+/* Notes the weight unit of every range and bounds the number of deals of
+ * them. Returns 0 on success.
+ */
+{
+  plan->weight_unit = calloc(sc->n_hands + 1, sizeof(*plan->weight_unit));
+  if (plan->weight_unit == NULL)
+  {
+    fprintf(stderr, "Failed to allocate memory for enumeration. Error: %d\n", errno);
+    return -1;
+  }
+  plan->n_deals = 1;
+  for (size_t h = 0; h < sc->n_hands; ++h)
+  {
+    const range_t *range = sc->ranges[h];
+    if (range == NULL) continue;
+    size_t n = 0;
+    for (size_t i = 0; i < range->n_combos; ++i)
+    {
+      if (range->combos[i] & sc->dead) continue;
+      plan->weight_unit[h] = gcd(plan->weight_unit[h], range->weights[i]);
+      ++n;
+    }
+    plan->n_deals *= n;
+    plan->n_hole_cards += 2;
+  }
+  return 0;
+}
+
+static enum_plan_t *make_enum_plan(scenario_t *sc)
+{
+  enum_plan_t *plan = calloc(1, sizeof(*plan));
+  size_t first_slot[DECK_SIZE];
+  if (plan == NULL)
+  {
+    fprintf(stderr, "Failed to allocate memory for enumeration. Error: %d\n", errno);
+    return NULL;
+  }
+  plan->sc = sc;
+  plan->n_deals = 1;
+  if (scenario_has_ranges(sc) && add_plan_ranges(plan, sc) != 0)
+  {
+    free_enum_plan(plan);
+    return NULL;
+  }
+  for (size_t s = 0; s < sc->n_slots; ++s)
+  {
+    if (!slot_is_used(sc, s)) continue;
+    size_t c = 0;
+    while (c < plan->n_classes && !same_holders(sc, first_slot[c], s))
+    {
+      ++c;
+    }
+    if (c == plan->n_classes)
+    {
+      if (plan->n_classes == DECK_SIZE)
+      {
+        fprintf(stderr, "Too many unknown cards to enumerate.\n");
+        free_enum_plan(plan);
+        return NULL;
+      }
+      first_slot[c] = s;
+      ++plan->n_classes;
+    }
+    ++plan->class_size[c];
+  }
+  plan->member = calloc(sc->n_hands * plan->n_classes + 1, sizeof(*plan->member));
+  if (plan->member == NULL)
+  {
+    fprintf(stderr, "Failed to allocate memory for enumeration. Error: %d\n", errno);
+    free_enum_plan(plan);
+    return NULL;
+  }
+  for (size_t h = 0; h < sc->n_hands; ++h)
+  {
+    for (size_t c = 0; c < plan->n_classes; ++c)
+    {
+      plan->member[h * plan->n_classes + c] = scenario_uses(sc, h, first_slot[c]);
+    }
+  }
+  plan->board_known = sc->n_hands > 0 ? CARDSET_FULL : CARDSET_EMPTY;
+  for (size_t h = 0; h < sc->n_hands; ++h)
+  {
+    plan->board_known &= sc->known[h];
+  }
+  for (size_t c = 0; c < plan->n_classes; ++c)
+  {
+    plan->shared[c] = sc->n_hands > 0;
+    for (size_t h = 0; h < sc->n_hands; ++h)
+    {
+      if (!plan->member[h * plan->n_classes + c]) plan->shared[c] = 0;
+    }
+  }
+  cardset_t left = cardset_complement(sc->dead);
+  while (left != CARDSET_EMPTY)
+  {
+    plan->remaining[plan->n_remaining++] = __builtin_ctzll(left);
+    left &= left - 1;
+  }
+  return plan;
+}
+
+static double choose(size_t n, size_t k)
+{
+  double r = 1;
+  if (k > n) return 0;
+  for (size_t i = 0; i < k; ++i)
+  {
+    r = r * (n - i) / (i + 1);
+  }
+  return r;
+}
+
+static double count_plan(enum_plan_t *plan)
+{
+  double total = plan->n_deals;
+  size_t avail = plan->n_remaining >= plan->n_hole_cards
+                 ? plan->n_remaining - plan->n_hole_cards : 0;
+  for (size_t c = 0; c < plan->n_classes; ++c)
+  {
+    total *= choose(avail, plan->class_size[c]);
+    avail = avail >= plan->class_size[c] ? avail - plan->class_size[c] : 0;
+  }
+  return total;
+}
+
+double count_enumeration(scenario_t *sc)
+/* Returns how many outcomes run_enumeration would visit (at most, if some
+ * deals of the ranges share a card), or -1 on error.
+ */
+{
+  enum_plan_t *plan = make_enum_plan(sc);
+  if (plan == NULL) return -1;
+  double total = count_plan(plan);
+  free_enum_plan(plan);
+  return total;
+}
+
+static void count_pending(enum_worker_t *w)
+/* Evaluates the hands of the pending outcomes and counts their showdowns. */
+{
+  size_t n_hands = w->plan->sc->n_hands;
+  cardset_strengths(w->sets, w->n_pending * n_hands, w->strengths);
+  for (size_t i = 0; i < w->n_pending; ++i)
+  {
+    record_showdown(w->strengths + i * n_hands, n_hands, w->pending_weight[i], w->res);
+  }
+  w->n_pending = 0;
+}
+
+static void enum_leaf(enum_worker_t *w)
+{
+  enum_plan_t *plan = w->plan;
+  scenario_t *sc = plan->sc;
+  cardset_t board = plan->board_known;
+  for (size_t c = 0; c < plan->n_classes; ++c)
+  {
+    if (plan->shared[c]) board |= w->class_cards[c];
+  }
+  cardset_t *sets = w->sets + w->n_pending * sc->n_hands;
+  for (size_t h = 0; h < sc->n_hands; ++h)
+  {
+    cardset_t own = w->own[h];
+    for (size_t c = 0; c < plan->n_classes; ++c)
+    {
+      if (plan->member[h * plan->n_classes + c] && !plan->shared[c]) own |= w->class_cards[c];
+    }
+    sets[h] = board | own;
+  }
+  w->pending_weight[w->n_pending] = w->weight[plan->n_classes];
+  if (++w->n_pending == ENUM_EVAL_LEAVES) count_pending(w);
+}
+
+static void enum_deal(enum_worker_t *w, size_t c, size_t left, size_t start, cardset_t used)
+/* Deals the remaining left cards of class c, choosing only cards at or after
+ * position start of the remaining deck so each combination is seen once.
+ */
+{
+  enum_plan_t *plan = w->plan;
+  if (c == plan->n_classes)
+  {
+    enum_leaf(w);
+    return;
+  }
+  if (left == 0)
+  {
+    suit_group_t stab = SUIT_GROUP_IDENTITY;
+    unsigned orbit = 1;
+    if (w->group[c] != SUIT_GROUP_IDENTITY &&
+        !suit_orbit_leader(w->class_cards[c], w->group[c], &stab, &orbit))
+    {
+      return;
+    }
+    if (c == 0 && w->counter++ % w->n_threads != w->index)
+    {
+      return;
+    }
+    w->group[c + 1] = stab;
+    w->weight[c + 1] = w->weight[c] * orbit;
+    size_t next = c + 1;
+    enum_deal(w, next, next < plan->n_classes ? plan->class_size[next] : 0, 0, used);
+    return;
+  }
+  for (size_t k = start; k + left <= plan->n_remaining; ++k)
+  {
+    cardset_t card = cardset_from_num(plan->remaining[k]);
+    if (used & card) continue;
+    w->class_cards[c] |= card;
+    enum_deal(w, c, left - 1, k + 1, used | card);
+    w->class_cards[c] &= ~card;
+  }
+}
+
+static void enum_ranges(enum_worker_t *w, size_t h, unsigned long long weight, cardset_t used)
+/* Deals the hands from h on that have a range every combination of it not
+ * in used, and enumerates the unknown cards of each complete deal.
+ */
+{
+  enum_plan_t *plan = w->plan;
+  scenario_t *sc = plan->sc;
+  while (h < sc->n_hands && (sc->ranges == NULL || sc->ranges[h] == NULL))
+  {
+    ++h;
+  }
+  if (h == sc->n_hands)
+  {
+    if (plan->n_classes == 0 && w->counter++ % w->n_threads != w->index)
+    {
+      return;
+    }
+    w->group[0] = suit_stabiliser(w->own, sc->n_hands + 1, SUIT_GROUP_ALL);
+    w->weight[0] = weight;
+    enum_deal(w, 0, plan->n_classes > 0 ? plan->class_size[0] : 0, 0, used);
+    return;
+  }
+  const range_t *range = sc->ranges[h];
+  cardset_t own = w->own[h];
+  for (size_t i = 0; i < range->n_combos; ++i)
+  {
+    cardset_t combo = range->combos[i];
+    if (combo & used) continue;
+    w->own[h] = own | combo;
+    enum_ranges(w, h + 1, weight * (range->weights[i] / plan->weight_unit[h]), used | combo);
+  }
+  w->own[h] = own;
+}
+
+static void *enum_worker_run(void *arg)
+{
+  enum_worker_t *w = arg;
+  enum_plan_t *plan = w->plan;
+  scenario_t *sc = plan->sc;
+  for (size_t h = 0; h < sc->n_hands; ++h)
+  {
+    w->own[h] = sc->known[h] & ~plan->board_known;
+  }
+  w->own[sc->n_hands] = plan->board_known;
+  enum_ranges(w, 0, 1, sc->dead);
+  count_pending(w);
+  return NULL;
+}
+
+sim_result_t *run_enumeration(scenario_t *sc, unsigned n_threads)
+/* Evaluates every outcome of the scenario on n_threads threads (0 picks one
+ * per online processor) and returns the exact counts, or NULL on error. The
+ * result's n_trials is the number of outcomes.
+ */
+{
+  enum_plan_t *plan = make_enum_plan(sc);
+  if (plan == NULL) return NULL;
+  size_t n_unknown = plan->n_hole_cards;
+  for (size_t c = 0; c < plan->n_classes; ++c)
+  {
+    n_unknown += plan->class_size[c];
+  }
+  if (n_unknown > plan->n_remaining)
+  {
+    fprintf(stderr, "Not enough cards left in the deck for %zu unknown cards.\n", n_unknown);
+    free_enum_plan(plan);
+    return NULL;
+  }
+  if (scenario_has_ranges(sc) && !ranges_can_deal(sc->ranges, sc->n_hands, sc->dead))
+  {
+    fprintf(stderr, "The ranges cannot all be dealt combinations without sharing a card.\n");
+    free_enum_plan(plan);
+    return NULL;
+  }
+  if (n_threads == 0) n_threads = default_thread_count();
+  double first = plan->n_classes > 0 ? choose(plan->n_remaining, plan->class_size[0])
+                                     : plan->n_deals;
+  if (n_threads > first) n_threads = (unsigned) first;
+  init_strength_tables();
+
+  sim_result_t *total = init_sim_result(sc->n_hands);
+  enum_worker_t *workers = calloc(n_threads, sizeof(*workers));
+  int failed = (total == NULL || workers == NULL);
+  unsigned n_ready = 0;
+  for (unsigned i = 0; !failed && i < n_threads; ++i)
+  {
+    workers[i].plan = plan;
+    workers[i].index = i;
+    workers[i].n_threads = n_threads;
+    size_t n_sets = ENUM_EVAL_LEAVES * sc->n_hands + 1;
+    workers[i].sets = malloc(sizeof(*workers[i].sets) * n_sets);
+    workers[i].strengths = malloc(sizeof(*workers[i].strengths) * n_sets);
+    workers[i].own = malloc(sizeof(*workers[i].own) * (sc->n_hands + 1));
+    workers[i].res = init_sim_result(sc->n_hands);
+    ++n_ready;
+    if (workers[i].sets == NULL || workers[i].strengths == NULL || workers[i].own == NULL ||
+        workers[i].res == NULL)
+    {
+      failed = 1;
+    }
+  }
+  if (failed)
+  {
+    fprintf(stderr, "Failed to allocate memory for enumeration. Error: %d\n", errno);
+  }
+  if (!failed && run_parallel(enum_worker_run, workers, sizeof(*workers), n_threads) != 0)
+  {
+    failed = 1;
+  }
+  for (unsigned i = 0; !failed && i < n_threads; ++i)
+  {
+    add_sim_result(total, workers[i].res);
+  }
+  for (unsigned i = 0; i < n_ready; ++i)
+  {
+    free(workers[i].sets);
+    free(workers[i].strengths);
+    free(workers[i].own);
+    free_sim_result(workers[i].res);
+  }
+  free(workers);
+  free_enum_plan(plan);
+  if (failed)
+  {
+    free_sim_result(total);
+    return NULL;
+  }
+  total->exact = 1;
+  return total;
+}
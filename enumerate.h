@@ -0,0 +1,8 @@
+#ifndef ENUMERATE_H
+#define ENUMERATE_H
+#include "scenario.h"
+#include "sim.h"
+
+double count_enumeration(scenario_t *sc);
+sim_result_t *run_enumeration(scenario_t *sc, unsigned n_threads);
+#endif
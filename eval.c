@@ -1,4 +1,6 @@
 #include "eval.h"
+#include "cardset.h"
+#include "strength.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
@@ -21,30 +23,18 @@ int card_ptr_comp(const void * vp1, const void * vp2)
   return difference != 0 ? difference : (*cp2)->suit - (*cp1)->suit;
 }
 
-suit_t flush_suit(deck_t * hand) 
-/* Function that determines if a hand is a flush (has at least 5 cards of one 
- * suit) exists. If so, it returns the suit of the cards comprising the flush. 
- * If not, it returns NUM_SUITS.
- * 
+suit_t flush_suit(deck_t * hand)
+/* Function that determines if a hand is a flush (has at least 5 cards of one
+ * suit) exists. If so, it returns the suit of the cards comprising the flush.
+ * If not, it returns NUM_SUITS. The cards of each suit are counted with a
+ * popcount of its rank mask (see cardset_flush_suit).
+ *
  * For example:
- * Given Ks Qs 0s 9h 8s 7s, it would return SPADES.  
+ * Given Ks Qs 0s 9h 8s 7s, it would return SPADES.
  * Given Kd Qd 0s 9h 8c 7c, it would return NUM_SUITS.
  */
 {
-  int card_suits[NUM_SUITS] = { 0 };
-  suit_t suit;
-  size_t n_cards = hand->n_cards;
-  card_t **cards = hand->cards;
-  for (size_t i = 0; i < n_cards; ++i)
-  {
-    suit = cards[i]->suit;
-    ++card_suits[suit];
-    if (card_suits[suit] > 4)
-    {
-      return suit;
-    }
-  }
-  return NUM_SUITS;
+  return cardset_flush_suit(cardset_from_deck(hand));
 }
 
 unsigned get_largest_element(unsigned * arr, size_t n)
@@ -113,94 +103,6 @@ ssize_t  find_secondary_pair(
 }
 
 
-int is_n_length_straight_at(deck_t * hand, size_t index, suit_t fs, int n)
-/* This function determines if there is a straight of length n, starting at 
- * index (and only  starting at index) in the given hand. If fs is NUM_SUITS, 
- * then it looks for any straight. If fs is some other value, then it looks for 
- * a straight flush in the specified suit. This function returns:
- *   0  if no straight was found at that index
- *   1  if a straight of length n was found at that index
- */
-{
-  if (n == 0)
-  {
-    return 1;
-  }
-  card_t **cards = hand->cards;
-  size_t n_cards = hand->n_cards;
-  int difference;
-  size_t i = index + 1;
-  while (i < n_cards)
-  {
-    difference = cards[index]->value - cards[i]->value;
-    if (difference > 1) return 0;
-    if (difference == 1 && (fs == NUM_SUITS || fs == cards[i]->suit))
-      {
-        return (is_n_length_straight_at(hand, i, fs, n - 1));
-      }
-    ++i;
-  }
-  return 0;
-}
-
-int is_ace_low_straight_at(deck_t * hand, size_t index, suit_t fs)
-/* Function to see if an ace low straight is found at index. If fs = NUM_SUITS
- * then it looks for any straight, otherwise it looks for one in the suit 
- * specified. It check for a 5. It then checks for an ace. And then for a 
- * straight of length 4.
- */
-{
-  card_t **cards = hand->cards;
-  size_t n_cards = hand->n_cards;
-  if (index >= n_cards || cards[index]->value != 14)
-  {
-    return 0; // Index not an ace
-  }
-  size_t i = index;
-  while (i < n_cards && ((cards[i]->value > 5) ||
-        (cards[i]->value == 5 && fs != NUM_SUITS && 
-        cards[i]->suit != fs)))
-  {
-    ++i; // Card value > 5 or card value is 5 but wrong suit
-  }
-  if (i >= n_cards || cards[i]->value != 5)
-  {
-    return 0; // 5 not found
-  }
-  return is_n_length_straight_at(hand, i, fs, 3);
-}
-
-int is_straight_at(deck_t * hand, size_t index, suit_t fs)
-/* This function determines if there is a straight starting at index (and only 
- * starting at index) in the given hand. If fs is NUM_SUITS, then it looks for 
- * any straight. If fs is some other value, then it looks for a straight flush 
- * in the specified suit. This function returns:
- *   -1 if an Ace-low straight was found at that index 
- *       (and that index is the Ace)
- *   0  if no straight was found at that index
- *   1  if any other straight was found at that index
- *
- */
-{
-  if (fs != NUM_SUITS && hand->cards[index]->suit != fs)
-  {
-    return 0; // Wrong suit
-  }
-  if (hand->cards[index]->value < 5) 
-  {
-    return 0;
-  }
-  if (is_n_length_straight_at(hand, index, fs, 4))
-  {
-    return 1;
-  }
-  if (is_ace_low_straight_at(hand, index, fs))
-  {
-    return -1;
-  }
-  return 0;
-}
-
 int card_in_card_array(card_t **cards, size_t size, card_t *card)
 {
   for (int i = 0; i < size; ++i)
@@ -273,14 +175,35 @@ hand_eval_t build_hand_from_match(
   return ans;
 }
 
+void sort_hand(deck_t * hand)
+/* Sorts the cards of a hand into the order evaluate_hand expects (see
+ * card_ptr_comp) with an insertion sort. Hands are a handful of cards and
+ * are usually already sorted by an earlier call, in which case this is a
+ * single pass. It never allocates.
+ */
+{
+  card_t **cards = hand->cards;
+  for (size_t i = 1; i < hand->n_cards; ++i)
+  {
+    card_t *card = cards[i];
+    size_t j = i;
+    while (j > 0 && card_ptr_comp(&cards[j - 1], &card) > 0)
+    {
+      cards[j] = cards[j - 1];
+      --j;
+    }
+    cards[j] = card;
+  }
+}
+
 int compare_hands(deck_t * hand1, deck_t * hand2)
 /* Function that compares 2 hands. It returns a positive number
 if hand 1 is better, 0 if the hands tie, and a negative number
 if hand 2 is better.
 */
 {
-  qsort(hand1->cards, hand1->n_cards, sizeof(hand1->cards[0]), card_ptr_comp);
-  qsort(hand2->cards, hand2->n_cards, sizeof(hand2->cards[0]), card_ptr_comp);
+  sort_hand(hand1);
+  sort_hand(hand2);
   hand_eval_t eval1 = evaluate_hand(hand1);
   hand_eval_t eval2 = evaluate_hand(hand2);
   hand_ranking_t rank1 = eval1.ranking;
@@ -326,103 +249,83 @@ unsigned * get_match_counts(deck_t * hand)
    1 ten, and 3 nines.
 */
   unsigned *arr = malloc(sizeof(*arr) * hand->n_cards);
-  int count, value;
+  if (arr == NULL)
+  {
+    fprintf(stderr, "Failed to allocate memory for match counts.\n");
+    return NULL;
+  }
+  fill_match_counts(hand, arr);
+  return arr;
+}
+
+void fill_match_counts(deck_t * hand, unsigned * counts)
+/* get_match_counts without the allocation: fills counts (which must have
+ * room for hand->n_cards entries) with the match count of each card. A
+ * histogram of the card values makes this O(n) instead of O(n^2).
+ */
+{
+  unsigned histogram[VALUE_ACE + 1] = { 0 };
+  card_t **cards = hand->cards;
   for (size_t i = 0; i < hand->n_cards; ++i)
   {
-    arr[i] = 0;
+    if (cards[i]->value <= VALUE_ACE) ++histogram[cards[i]->value];
   }
   for (size_t i = 0; i < hand->n_cards; ++i)
   {
-    if (arr[i] == 0)
-    {
-      value = hand->cards[i]->value;
-      count = 1;
-      for (size_t j = i + 1; j < hand->n_cards; ++j)
-      {
-        if (hand->cards[j]->value == value)
-        {
-          ++count;
-        }
-      }
-      arr[i] = count;
-      for (size_t j = i + 1; j < hand->n_cards; ++j)
-      {
-        if (hand->cards[j]->value == value)
-        {
-          arr[j] = count;
-        }
-      }
-    }
+    counts[i] = cards[i]->value <= VALUE_ACE ? histogram[cards[i]->value] : 1;
   }
-  return arr;
 }
 
-// We provide the below functions.  You do NOT need to modify them
-// In fact, you should not modify them!
+#define ALWAYS_INLINE static inline __attribute__((always_inline))
 
-//This function copies a straight starting at index "ind" from deck "from".
-//This copies "count" cards (typically 5).
-//into the card array "to"
-//if "fs" is NUM_SUITS, then suits are ignored.
-//if "fs" is any other value, a straight flush (of that suit) is copied.
-void copy_straight(card_t ** to, deck_t *from, size_t ind, suit_t fs, size_t count) {
-  assert(fs == NUM_SUITS || from->cards[ind]->suit == fs);
-  unsigned nextv = from->cards[ind]->value;
-  size_t to_ind = 0;
-  while (count > 0) {
-    assert(ind < from->n_cards);
-    assert(nextv >= 2);
-    assert(to_ind <5);
-    if (from->cards[ind]->value == nextv &&
-	(fs == NUM_SUITS || from->cards[ind]->suit == fs)){
-      to[to_ind] = from->cards[ind];
-      to_ind++;
-      count--;
-      nextv--;
+ALWAYS_INLINE void copy_straight(
+      hand_eval_t * ans, card_t ** cards, const size_t n, unsigned top, suit_t fs)
+/* Copies the straight (flush, unless fs is NUM_SUITS) with top value top
+ * from the n sorted cards into ans, highest first, taking the first card of
+ * each value. Cards are visited from the end so that the first one written
+ * last wins.
+ */
+{
+  for (size_t i = n; i-- > 0;)
+  {
+    unsigned value = cards[i]->value;
+    if (value == VALUE_ACE && top == 5) value = 1;
+    if (value <= top && value + 4 >= top && (fs == NUM_SUITS || cards[i]->suit == fs))
+    {
+      ans->cards[top - value] = cards[i];
     }
-    ind++;
   }
 }
 
-
-//This looks for a straight (or straight flush if "fs" is not NUM_SUITS)
-// in "hand".  It calls the student's is_straight_at for each possible
-// index to do the work of detecting the straight.
-// If one is found, copy_straight is used to copy the cards into
-// "ans".
-int find_straight(deck_t * hand, suit_t fs, hand_eval_t * ans) {
-  if (hand->n_cards < 5){
-    return 0;
+int find_straight(deck_t * hand, suit_t fs, hand_eval_t * ans)
+/* Looks for the best straight (straight flush of suit fs, unless fs is
+ * NUM_SUITS) in a sorted hand and copies its cards into ans. The straight is
+ * read off the rank mask of the hand by rank_mask_straight_high instead of
+ * scanning the cards. Returns 1 if there is one and 0 otherwise.
+ */
+{
+  cardset_t set = cardset_from_deck(hand);
+  unsigned ranks = 0;
+  for (int s = 0; s < NUM_SUITS; ++s)
+  {
+    if (fs == NUM_SUITS || fs == s) ranks |= cardset_suit(set, s);
   }
-  for(size_t i = 0; i <= hand->n_cards -5; i++) {
-    int x = is_straight_at(hand, i, fs);
-    if (x != 0){
-      if (x < 0) { //ace low straight
-	assert(hand->cards[i]->value == VALUE_ACE &&
-	       (fs == NUM_SUITS || hand->cards[i]->suit == fs));
-	ans->cards[4] = hand->cards[i];
-	size_t cpind = i+1;
-	while(hand->cards[cpind]->value != 5 ||
-	      !(fs==NUM_SUITS || hand->cards[cpind]->suit ==fs)){
-	  cpind++;
-	  assert(cpind < hand->n_cards);
-	}
-	copy_straight(ans->cards, hand, cpind, fs,4) ;
-      }
-      else {
-	copy_straight(ans->cards, hand, i, fs,5);
-      }
-      return 1;
-    }
+  unsigned top = rank_mask_straight_high(ranks);
+  if (top == 0)
+  {
+    return 0;
   }
-  return 0;
+  copy_straight(ans, hand->cards, hand->n_cards, top, fs);
+  return 1;
 }
 
 
 //This function puts all the hand evaluation logic together.
 //This function is longer than we generally like to make functions,
 //and is thus not so great for readability :(
-hand_eval_t evaluate_hand(deck_t * hand) {
+//evaluate_hand uses it for hands of other than 5 to 7 cards; tests check
+//the specialised paths against it.
+hand_eval_t evaluate_hand_generic(deck_t * hand) {
   suit_t fs = flush_suit(hand);
   hand_eval_t ans;
   if (fs != NUM_SUITS) {
@@ -431,12 +334,23 @@ hand_eval_t evaluate_hand(deck_t * hand) {
       return ans;
     }
   }
-  unsigned * match_counts = get_match_counts(hand);
+  //A hand holds at most DECK_SIZE distinct cards, so the match counts fit
+  //on the stack and evaluation never touches the heap.
+  unsigned stack_counts[DECK_SIZE];
+  unsigned * match_counts = stack_counts;
+  if (hand->n_cards > DECK_SIZE) {
+    match_counts = get_match_counts(hand);
+  }
+  else {
+    fill_match_counts(hand, match_counts);
+  }
   unsigned n_of_a_kind = get_largest_element(match_counts, hand->n_cards);
   assert(n_of_a_kind <= 4);
   size_t match_idx = get_match_index(match_counts, hand->n_cards, n_of_a_kind);
   ssize_t other_pair_idx = find_secondary_pair(hand, match_counts, match_idx);
-  free(match_counts);
+  if (match_counts != stack_counts) {
+    free(match_counts);
+  }
   if (n_of_a_kind == 4) { //4 of a kind
     return build_hand_from_match(hand, 4, FOUR_OF_A_KIND, match_idx);
   }
@@ -489,3 +403,146 @@ hand_eval_t evaluate_hand(deck_t * hand) {
   }
   return build_hand_from_match(hand, 0, NOTHING, 0);
 }
+
+/* Fixed-size evaluation. evaluate_fixed gives the same answer as
+ * evaluate_hand_generic, card for card, for a sorted hand of exactly n <= 7
+ * cards. DEFINE_FIXED_EVALUATOR instantiates it with a constant n, so every
+ * loop over the cards is unrolled. Suits are counted one per nibble and
+ * straights are looked up by the mask of the values held, like
+ * find_straight.
+ */
+ALWAYS_INLINE hand_eval_t build_fixed(
+      card_t ** cards, const size_t n, hand_ranking_t what, size_t idx, unsigned k)
+/* build_hand_from_match for the k matching cards at idx: those, then the
+ * highest of the other cards.
+ */
+{
+  hand_eval_t ans;
+  ans.ranking = what;
+  size_t filled = 0;
+  for (size_t i = 0; i < k; ++i)
+  {
+    ans.cards[filled++] = cards[idx + i];
+  }
+  for (size_t i = 0; i < n && filled < 5; ++i)
+  {
+    if (i < idx || i >= idx + k) ans.cards[filled++] = cards[i];
+  }
+  return ans;
+}
+
+ALWAYS_INLINE hand_eval_t evaluate_fixed(deck_t * hand, const size_t n)
+{
+  card_t **cards = hand->cards;
+  unsigned suit_counts = 0;
+  unsigned values = 0;
+  unsigned suit_values[NUM_SUITS] = { 0 };
+  unsigned histogram[VALUE_ACE + 1] = { 0 };
+  for (size_t i = 0; i < n; ++i)
+  {
+    unsigned bit = (1u << cards[i]->value) & ~1u;
+    suit_counts += 1u << 4 * cards[i]->suit;
+    suit_values[cards[i]->suit] |= bit;
+    values |= bit;
+    ++histogram[cards[i]->value];
+  }
+  /* A nibble holds at most 7, so adding 3 carries into its top bit exactly
+   * when the suit has 5 or more cards. */
+  unsigned flushes = (suit_counts + 0x3333u) & 0x8888u;
+  suit_t fs = flushes != 0 ? __builtin_ctz(flushes) / 4 : NUM_SUITS;
+  hand_eval_t ans;
+  if (fs != NUM_SUITS)
+  {
+    unsigned top = rank_mask_straight_high(suit_values[fs] >> 2);
+    if (top != 0)
+    {
+      ans.ranking = STRAIGHT_FLUSH;
+      copy_straight(&ans, cards, n, top, fs);
+      return ans;
+    }
+  }
+  unsigned n_of_a_kind = 0;
+  for (size_t i = 0; i < n; ++i)
+  {
+    unsigned count = histogram[cards[i]->value];
+    n_of_a_kind = count > n_of_a_kind ? count : n_of_a_kind;
+  }
+  size_t match_idx = 0;
+  for (size_t i = n; i-- > 0;)
+  {
+    if (histogram[cards[i]->value] == n_of_a_kind) match_idx = i;
+  }
+  ssize_t other_pair_idx = -1;
+  for (size_t i = n; i-- > 0;)
+  {
+    if (cards[i]->value != cards[match_idx]->value && histogram[cards[i]->value] > 1)
+    {
+      other_pair_idx = i;
+    }
+  }
+  if (n_of_a_kind == 4)
+  {
+    return build_fixed(cards, n, FOUR_OF_A_KIND, match_idx, 4);
+  }
+  if (n_of_a_kind == 3 && other_pair_idx >= 0)
+  {
+    ans = build_fixed(cards, n, FULL_HOUSE, match_idx, 3);
+    ans.cards[3] = cards[other_pair_idx];
+    ans.cards[4] = cards[other_pair_idx + 1];
+    return ans;
+  }
+  if (fs != NUM_SUITS)
+  {
+    ans.ranking = FLUSH;
+    size_t copied = 0;
+    for (size_t i = 0; i < n && copied < 5; ++i)
+    {
+      if (cards[i]->suit == fs) ans.cards[copied++] = cards[i];
+    }
+    return ans;
+  }
+  unsigned top = rank_mask_straight_high(values >> 2);
+  if (top != 0)
+  {
+    ans.ranking = STRAIGHT;
+    copy_straight(&ans, cards, n, top, NUM_SUITS);
+    return ans;
+  }
+  if (n_of_a_kind == 3)
+  {
+    return build_fixed(cards, n, THREE_OF_A_KIND, match_idx, 3);
+  }
+  if (other_pair_idx >= 0)
+  {
+    ans = build_fixed(cards, n, TWO_PAIR, match_idx, 2);
+    ans.cards[2] = cards[other_pair_idx];
+    ans.cards[3] = cards[other_pair_idx + 1];
+    ans.cards[4] = cards[match_idx > 0 ? 0 : other_pair_idx > 2 ? 2 : 4];
+    return ans;
+  }
+  return build_fixed(cards, n, n_of_a_kind == 2 ? PAIR : NOTHING, match_idx, n_of_a_kind == 2 ? 2 : 0);
+}
+
+#define DEFINE_FIXED_EVALUATOR(n)                   \
+  static hand_eval_t evaluate_hand_##n(deck_t * hand) \
+  {                                                   \
+    return evaluate_fixed(hand, n);                   \
+  }
+
+DEFINE_FIXED_EVALUATOR(5)
+DEFINE_FIXED_EVALUATOR(6)
+DEFINE_FIXED_EVALUATOR(7)
+
+hand_eval_t evaluate_hand(deck_t * hand)
+/* Evaluates a hand sorted by sort_hand. Hands of 5, 6 and 7 cards take the
+ * specialised path and all others the generic one.
+ */
+{
+  switch (hand->n_cards)
+  {
+    case 5: return evaluate_hand_5(hand);
+    case 6: return evaluate_hand_6(hand);
+    case 7: return evaluate_hand_7(hand);
+  }
+  return evaluate_hand_generic(hand);
+}
@@ -8,6 +8,9 @@ struct hand_eval_tag {
 typedef struct hand_eval_tag hand_eval_t;
 
 hand_eval_t evaluate_hand(deck_t * hand);
+hand_eval_t evaluate_hand_generic(deck_t * hand);
 int compare_hands(deck_t * hand1, deck_t * hand2);
 unsigned *get_match_counts(deck_t * hand);
+void fill_match_counts(deck_t * hand, unsigned * counts);
+void sort_hand(deck_t * hand);
 #endif
@@ -1,99 +1,283 @@
-#include <errno.h>
-#include <stdio.h>
-#include "cards.h"
-#include "deck.h"
-#include "future.h"
-
-void print_future_cards(future_cards_t *fc)
-{
-    size_t last;
-    printf("------------------------\n");
-    for (int i = 0; i < fc->n_decks; ++i)
-    {
-        if (1)//(fc->decks[i].n_cards > 0)
-        {
-            printf("index: %d [", i);
-            last = fc->decks[i].n_cards - 1;
-            for (int j = 0; j < fc->decks[i].n_cards; ++j)
-            {
-                print_card(*fc->decks[i].cards[j]);
-                if (j < last)
-                {
-                    printf(", ");
-                }
-            }
-            printf("]\n");
-        }
-    }
-    printf("------------------------\n");
-}
-
-void add_future_card(future_cards_t * fc, size_t index, card_t * ptr)
-{
-    deck_t *new_decks = NULL;
-    deck_t *new_deck = NULL;
-    while (index >= fc->n_decks)
-    {
-        new_deck = initialize_deck();
-        if (new_deck == NULL)
-        {
-            fprintf(stderr, "Memory failed to add deck to future cards. Error %d\n", errno);
-            return;
-        }
-        new_decks = realloc(fc->decks, sizeof(*fc->decks) * (fc->n_decks + 1));
-        if (new_decks == NULL)
-        {
-            fprintf(stderr, "Failed to allocate more memory to future card deck. Error: %d\n", errno);
-            return;
-        }
-        fc->decks = new_decks;
-        fc->decks[fc->n_decks] = *new_deck;
-        ++fc->n_decks;
-    }
-    add_card_pointer_to_deck(&fc->decks[index], ptr);
-}
-
-void future_cards_from_deck(deck_t * deck, future_cards_t * fc)
-{
-    int index = 0;
-    
-    for (size_t i = 0; i < fc->n_decks; ++i)
-    {
-        for (size_t j = 0; j < fc->decks[i].n_cards; ++j)
-        {
-            fc->decks[i].cards[j]->suit = deck->cards[index]->suit;
-            fc->decks[i].cards[j]->value = deck->cards[index]->value;
-        }
-        ++index;
-    }
-}
-
-future_cards_t *init_future_cards(void)
-{
-    future_cards_t *fc = malloc(sizeof(*fc));
-    if (fc == NULL)
-    {
-        fprintf(stderr, "Failed to allocate memory for unknown cards. Error: %d\n", errno);
-        return NULL;
-    }
-    fc->decks = NULL;
-    fc->n_decks = 0;
-    return fc;
-}
-
-void free_future_cards(future_cards_t *fc)
-{
-    if (fc == NULL) return;
-    for (int i = 0; i < fc->n_decks; ++i)
-    {
-        if (fc->decks[i].cards != NULL)
-        {
-            free(fc->decks[i].cards);
-        }
-    }
-    if (fc->decks != NULL)
-    {
-        free(fc->decks);
-    }
-    free(fc);
-}
+#include <errno.h>
+#include <stdio.h>
+#include "cards.h"
+#include "deck.h"
+#include "future.h"
+
+void print_future_cards(future_cards_t *fc)
+{
+    size_t last;
+    printf("------------------------\n");
+    for (int i = 0; i < fc->n_decks; ++i)
+    {
+        if (1)//(fc->decks[i].n_cards > 0)
+        {
+            printf("index: %d [", i);
+            last = fc->decks[i].n_cards - 1;
+            for (int j = 0; j < fc->decks[i].n_cards; ++j)
+            {
+                print_card(*fc->decks[i].cards[j]);
+                if (j < last)
+                {
+                    printf(", ");
+                }
+            }
+            printf("]\n");
+        }
+    }
+    printf("------------------------\n");
+}
+
+static long placeholder_index(future_cards_t *fc, const card_t *card)
+/* The n of the placeholder ?n that card is, or -1. */
+{
+    for (size_t i = 0; i < fc->n_decks; ++i)
+    {
+        for (size_t j = 0; j < fc->decks[i].n_cards; ++j)
+        {
+            if (fc->decks[i].cards[j] == card)
+            {
+                return i;
+            }
+        }
+    }
+    return -1;
+}
+
+void fprint_future_hand(FILE *f, deck_t *hand, future_cards_t *fc)
+/*
+   Prints hand as the input wrote it: the range its hole cards come from
+   (see fprint_range) first, and its placeholders as ?n. The cards are in
+   the hand's order, which may have been sorted since.
+*/
+{
+    range_t *range = range_of_hand(fc, hand);
+    int first = 1;
+    if (range != NULL)
+    {
+        fprint_range(f, range);
+        first = 0;
+    }
+    for (size_t i = 0; i < hand->n_cards; ++i)
+    {
+        card_t *card = hand->cards[i];
+        long index = card->value == 0 ? placeholder_index(fc, card) : -1;
+        if (card->value == 0 && index < 0)
+        {
+            continue;   /* a hole card from the range */
+        }
+        if (!first)
+        {
+            fprintf(f, " ");
+        }
+        first = 0;
+        if (index >= 0)
+        {
+            fprintf(f, "?%ld", index);
+        }
+        else
+        {
+            fprint_card(f, *card);
+        }
+    }
+}
+
+void add_future_card(future_cards_t * fc, size_t index, card_t * ptr)
+{
+    deck_t *new_decks = NULL;
+    if (index >= fc->n_decks)
+    {
+        size_t size = sizeof(*fc->decks) * (index + 1);
+        if (fc->arena != NULL)
+        {
+            new_decks = arena_realloc(fc->arena, fc->decks, sizeof(*fc->decks) * fc->n_decks, size);
+        }
+        else
+        {
+            new_decks = realloc(fc->decks, size);
+        }
+        if (new_decks == NULL)
+        {
+            fprintf(stderr, "Failed to allocate more memory to future card deck. Error: %d\n", errno);
+            return;
+        }
+        fc->decks = new_decks;
+        while (fc->n_decks <= index)
+        {
+            initialize_deck_struct(&fc->decks[fc->n_decks], fc->arena);
+            ++fc->n_decks;
+        }
+    }
+    add_card_pointer_to_deck(&fc->decks[index], ptr);
+}
+
+int add_range(future_cards_t *fc, deck_t *hand, range_t *range)
+/*
+   Records that the hole cards of hand are drawn from range, which fc takes
+   over. Returns 0 on success; on error the range is freed.
+*/
+{
+    hand_range_t *new_ranges;
+    size_t size = sizeof(*fc->ranges) * (fc->n_ranges + 1);
+    if (fc->arena != NULL)
+    {
+        new_ranges = arena_realloc(fc->arena, fc->ranges, sizeof(*fc->ranges) * fc->n_ranges, size);
+    }
+    else
+    {
+        new_ranges = realloc(fc->ranges, size);
+    }
+    if (new_ranges == NULL)
+    {
+        fprintf(stderr, "Failed to allocate memory for range. Error: %d\n", errno);
+        free_range(range);
+        return -1;
+    }
+    fc->ranges = new_ranges;
+    fc->ranges[fc->n_ranges].hand = hand;
+    fc->ranges[fc->n_ranges].range = range;
+    ++fc->n_ranges;
+    return 0;
+}
+
+range_t *range_of_hand(future_cards_t *fc, deck_t *hand)
+/* Returns the range of hand's hole cards, or NULL if it has none. */
+{
+    for (size_t i = 0; i < fc->n_ranges; ++i)
+    {
+        if (fc->ranges[i].hand == hand)
+        {
+            return fc->ranges[i].range;
+        }
+    }
+    return NULL;
+}
+
+void future_cards_from_deck(deck_t * deck, future_cards_t * fc)
+{
+    int index = 0;
+
+    if (deck->n_cards < fc->n_decks)
+    {
+        fprintf(stderr, "Not enough cards in deck (%zu) to draw %zu unknown cards.\n", deck->n_cards, fc->n_decks);
+        return;
+    }
+    for (size_t i = 0; i < fc->n_decks; ++i)
+    {
+        for (size_t j = 0; j < fc->decks[i].n_cards; ++j)
+        {
+            fc->decks[i].cards[j]->suit = deck->cards[index]->suit;
+            fc->decks[i].cards[j]->value = deck->cards[index]->value;
+        }
+        ++index;
+    }
+}
+
+future_cards_t *init_future_cards(void)
+{
+    return init_future_cards_in(NULL);
+}
+
+future_cards_t *init_future_cards_in(arena_t *arena)
+/*
+   Creates an empty set of unknown cards allocated from arena (or with malloc
+   if arena is NULL). Hands read with it by read_input are carved from the
+   same arena, so a whole scenario is released with reset_arena/free_arena.
+*/
+{
+    future_cards_t *fc = arena != NULL ? arena_alloc(arena, sizeof(*fc)) : malloc(sizeof(*fc));
+    if (fc == NULL)
+    {
+        fprintf(stderr, "Failed to allocate memory for unknown cards. Error: %d\n", errno);
+        return NULL;
+    }
+    fc->decks = NULL;
+    fc->n_decks = 0;
+    fc->ranges = NULL;
+    fc->n_ranges = 0;
+    fc->arena = arena;
+    return fc;
+}
+
+void free_future_cards(future_cards_t *fc)
+{
+    if (fc == NULL || fc->arena != NULL) return;
+    for (int i = 0; i < fc->n_decks; ++i)
+    {
+        if (fc->decks[i].cards != NULL)
+        {
+            free(fc->decks[i].cards);
+        }
+    }
+    if (fc->decks != NULL)
+    {
+        free(fc->decks);
+    }
+    for (size_t i = 0; i < fc->n_ranges; ++i)
+    {
+        free_range(fc->ranges[i].range);
+    }
+    free(fc->ranges);
+    free(fc);
+}
+
+future_cards_t *copy_future_cards(future_cards_t *fc, deck_t **from, deck_t **to, size_t n_hands)
+/*
+   Builds a future_cards_t for the hands in to, which must be copies of the
+   hands in from (see copy_deck). Every placeholder pointer in fc points into
+   one of the hands in from; the copy points at the card in the same position
+   of the matching hand in to.
+*/
+{
+    return copy_future_cards_in(fc, from, to, n_hands, NULL);
+}
+
+future_cards_t *copy_future_cards_in(future_cards_t *fc, deck_t **from, deck_t **to,
+                                     size_t n_hands, arena_t *arena)
+{
+    future_cards_t *copy = init_future_cards_in(arena);
+    if (copy == NULL)
+    {
+        return NULL;
+    }
+    for (size_t i = 0; i < fc->n_decks; ++i)
+    {
+        for (size_t j = 0; j < fc->decks[i].n_cards; ++j)
+        {
+            card_t *ptr = fc->decks[i].cards[j];
+            card_t *mapped = NULL;
+            for (size_t h = 0; h < n_hands && mapped == NULL; ++h)
+            {
+                for (size_t k = 0; k < from[h]->n_cards; ++k)
+                {
+                    if (from[h]->cards[k] == ptr)
+                    {
+                        mapped = to[h]->cards[k];
+                        break;
+                    }
+                }
+            }
+            if (mapped == NULL)
+            {
+                fprintf(stderr, "Unknown card ?%zu does not belong to any hand.\n", i);
+                free_future_cards(copy);
+                return NULL;
+            }
+            add_future_card(copy, i, mapped);
+        }
+    }
+    for (size_t i = 0; i < fc->n_ranges; ++i)
+    {
+        for (size_t h = 0; h < n_hands; ++h)
+        {
+            if (from[h] != fc->ranges[i].hand) continue;
+            range_t *range = copy_range_in(fc->ranges[i].range, arena);
+            if (range == NULL || add_range(copy, to[h], range) != 0)
+            {
+                free_future_cards(copy);
+                return NULL;
+            }
+        }
+    }
+    return copy;
+}
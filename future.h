@@ -1,15 +1,33 @@
 #ifndef FUTURE_H
 #define FUTURE_H
 #include "deck.h"
+#include "range.h"
+
+/* A hand whose two hole cards come from a range instead of the input. */
+struct hand_range_tag {
+  deck_t *hand;
+  range_t *range;
+};
+typedef struct hand_range_tag hand_range_t;
 
 struct future_cards_tag {
   deck_t * decks;
   size_t n_decks;
+  hand_range_t *ranges;
+  size_t n_ranges;
+  arena_t *arena;  /* owner of decks and of hands read with it, or NULL */
 };
 typedef struct future_cards_tag future_cards_t;
 void add_future_card(future_cards_t * fc, size_t index, card_t * ptr) ;
+int add_range(future_cards_t *fc, deck_t *hand, range_t *range);
+range_t *range_of_hand(future_cards_t *fc, deck_t *hand);
 void future_cards_from_deck(deck_t * deck, future_cards_t * fc);
 future_cards_t *init_future_cards(void);
+future_cards_t *init_future_cards_in(arena_t *arena);
 void print_future_cards(future_cards_t *fc);
+void fprint_future_hand(FILE *f, deck_t *hand, future_cards_t *fc);
 void free_future_cards(future_cards_t *fc);
+future_cards_t *copy_future_cards(future_cards_t *fc, deck_t **from, deck_t **to, size_t n_hands);
+future_cards_t *copy_future_cards_in(future_cards_t *fc, deck_t **from, deck_t **to,
+                                     size_t n_hands, arena_t *arena);
 #endif
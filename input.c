@@ -1,182 +1,451 @@
-#include <errno.h>
-#include <stdio.h>
-#include <string.h>
-#include "cards.h"
-#include "deck.h"
-#include "future.h"
-
-#define CHAR_LIMIT 4
-#define LAST CHAR_LIMIT - 1
-
-int is_white_space(char c)
-{
-    return((c >= 9 && c <= 13) || c == 32 || c == 133 || c == 160);
-}
-
-char *trim_hand(const char *str)
-{
-    size_t start = 0;
-    while (is_white_space(str[start]))
-    {
-        ++start;
-    }
-    if (str[start] == '\0')
-    {
-        return NULL;
-    }
-    size_t end = strlen(str) - 1;
-    while (is_white_space(str[end]))
-    {
-        --end;
-    }
-    char *trimmed = malloc(sizeof(*trimmed) * (end - start + 2));
-    size_t i = 0;
-    while (start <= end)
-    {
-        trimmed[i++] = str[start++];
-    }
-    trimmed[i] = '\0';
-    return trimmed;
-}
-
-char *card_from_string(const char *str, size_t *index, char *c, size_t length)
-{
-    while (is_white_space(str[*index]))
-    {
-        ++*index;
-    }
-    if (str[*index] == '\0') return NULL;
-    size_t i = 0;
-    while (i < LAST && (!is_white_space(str[*index]) && str[*index] != '\0'))
-    {
-        c[i++] = str[*index++];
-    }
-    c[i] = '\0';
-    return c;
-}
-
-deck_t * hand_from_string(const char * str, future_cards_t * fc)
-{
-    deck_t *hand = initialize_deck();
-    card_t card;
-    card_t *card_p;
-    char c[CHAR_LIMIT];
-
-    size_t start = 0;
-    size_t end;
-    size_t length = strlen(str);
-    size_t i;
-    int index;
-
-    while (start < length)
-    {
-        if (is_white_space(str[start]))
-        {
-            ++start;
-        }
-        end = start;
-        while (!is_white_space(str[end]) && str[end] != '\0')
-        {
-            ++end;
-        }
-        if (start < end)
-        {
-            i = 0;
-            while (start < end && i < LAST)
-            {
-                c[i++] = str[start++];
-            }
-            c[i] = '\0';
-        }
-        if (c[0] == '?')
-        {
-            // This is a future card
-            index = atoi(c + 1);
-            if (index >= DECK_SIZE)
-            {
-                fprintf(stderr, "Invalid card index.\n");
-                continue;
-            }
-            card_p = add_empty_card(hand);
-            if (card_p == NULL)
-            {
-                fprintf(stderr, "Failed to add future card to hand.\n");
-                continue;
-            }
-            add_future_card(fc, index, card_p);
-        }
-        else
-        {
-            card = card_from_letters(c[0], c[1]);
-            if (!is_card_valid(card))
-            {
-                fprintf(stderr, "Invalid card.\n");
-                continue;
-            }
-            add_card_to(hand, card);
-        }
-    }
-    return hand;
-}
-
-deck_t ** read_input(FILE * f, size_t * n_hands, future_cards_t * fc)
-/*
-   This function reads the input from f. The input file has one hand per line 
-   (a hand is of type deck_t). A deck_t type deck is allocated for each hand
-   and it is placed into an array of pointers to deck_t decks, which is 
-   returned. The number of decks is passed back trough the n_hands pointer.
-   
-   For any future future cards (?0, ?1, ...) in the deck, the add_empty_card is 
-   used to create a placeholder in the hand. The add_future_card function is 
-   used later to make sure the hand is updated correctly when cards are drawn 
-   later. 
-   
-   The code assumes that a poker hand has AT LEAST 5 cards in it. If there are 
-   fewer than 5 cards, a useful error message is printed before exit.
-*/
-{
-    deck_t **hands = NULL;
-    deck_t **new_hands = NULL;
-    deck_t *new_hand = NULL;
-
-    char *line = NULL;
-    char *trimmed = NULL;
-    size_t size = 0;
-    ssize_t length = 0;
-
-    while ((length = getline(&line, &size, f)) > 0)
-    {
-        trimmed = trim_hand(line);
-        if (trimmed == NULL) continue;
-        new_hand = hand_from_string(trimmed, fc);
-        if (new_hand->n_cards < 5)
-        {
-            fprintf(stderr, "Not enough cards in hand.\n");
-            free_deck(new_hand);
-            for (size_t i = 0; i < *n_hands; ++i)
-            {
-                free_deck(hands[i]);
-            }
-            free(hands);
-            return NULL;
-        }
-        new_hands = realloc(hands, sizeof(*hands) * (*n_hands + 1));
-        if (new_hands == NULL)
-        {
-            fprintf(stderr, "Failed to allocate memorfy for hand. Error: %d\n", errno);
-            free_deck(new_hand);
-            free_decks(hands, *n_hands);
-            *n_hands = 0;
-            return NULL;
-        }
-        hands = new_hands;
-        hands[*n_hands] = new_hand;
-        ++*n_hands;
-        free(trimmed);
-    }
-    if (line != NULL)
-    {
-        free(line);
-    }
-    return hands;
-}
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "cards.h"
+#include "deck.h"
+#include "future.h"
+#include "range.h"
+
+#define INPUT_CHUNK (1 << 16)
+
+/* Byte classes for the tokenizer: the value of a value letter, one more than
+   the suit of a suit letter, and which bytes are white space. Everything
+   else is 0. */
+static const unsigned char value_of[256] = {
+    ['2'] = 2, ['3'] = 3, ['4'] = 4, ['5'] = 5, ['6'] = 6, ['7'] = 7,
+    ['8'] = 8, ['9'] = 9, ['0'] = 10, ['J'] = VALUE_JACK, ['Q'] = VALUE_QUEEN,
+    ['K'] = VALUE_KING, ['A'] = VALUE_ACE
+};
+static const unsigned char suit_of[256] = {
+    ['s'] = SPADES + 1, ['h'] = HEARTS + 1, ['d'] = DIAMONDS + 1, ['c'] = CLUBS + 1
+};
+static const unsigned char is_blank[256] = {
+    ['\t'] = 1, ['\n'] = 1, ['\v'] = 1, ['\f'] = 1, ['\r'] = 1, [' '] = 1
+};
+
+struct input_pos_tag {
+    const char *name;   /* the input, for messages */
+    size_t line;        /* 1-based number of the line being parsed */
+    const char *start;  /* its first byte */
+};
+typedef struct input_pos_tag input_pos_t;
+
+static void report(const input_pos_t *pos, const char *at, const char *format, ...)
+/*
+   Prints an error about the byte at of the current line (or about the whole
+   line if at is NULL) to stderr, prefixed with name:line:column.
+*/
+{
+    va_list args;
+    fprintf(stderr, "%s:%zu:", pos->name, pos->line);
+    if (at != NULL)
+    {
+        fprintf(stderr, "%zu:", (size_t) (at - pos->start) + 1);
+    }
+    fputc(' ', stderr);
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+    fputc('\n', stderr);
+}
+
+static const char *skip_blanks(const char *p, const char *end)
+{
+    while (p < end && is_blank[(unsigned char) *p])
+    {
+        ++p;
+    }
+    return p;
+}
+
+static const char *token_end(const char *p, const char *end)
+{
+    while (p < end && !is_blank[(unsigned char) *p])
+    {
+        ++p;
+    }
+    return p;
+}
+
+static const char *take_range(const char *open, const char *end, deck_t *hand,
+                              future_cards_t *fc, const input_pos_t *pos)
+/*
+   Parses the range in square brackets at open and gives hand two
+   placeholder hole cards drawn from it (see add_range). Returns a pointer
+   just past the closing bracket, or NULL on error.
+*/
+{
+    const char *close = memchr(open, ']', end - open);
+    if (close == NULL)
+    {
+        report(pos, open, "Missing ']' after range.");
+        return NULL;
+    }
+    range_t *range = parse_range(open + 1, close - open - 1, fc->arena);
+    if (range == NULL)
+    {
+        report(pos, open, "Invalid range.");
+        return NULL;
+    }
+    if (add_empty_card(hand) == NULL || add_empty_card(hand) == NULL)
+    {
+        fprintf(stderr, "Failed to add range cards to hand.\n");
+        free_range(range);
+        return NULL;
+    }
+    return add_range(fc, hand, range) == 0 ? close + 1 : NULL;
+}
+
+static int add_token(const char *token, const char *end, deck_t *hand,
+                     future_cards_t *fc, const input_pos_t *pos)
+/*
+   Adds the card or placeholder ?n spelled by the bytes from token to end to
+   hand. Returns 0 on success and -1 on error.
+*/
+{
+    size_t length = end - token;
+    if (token[0] == '?')
+    {
+        size_t index = 0;
+        const char *p = token + 1;
+        while (p < end && *p >= '0' && *p <= '9' && index < DECK_SIZE)
+        {
+            index = index * 10 + (*p++ - '0');
+        }
+        if (p == token + 1 || p < end || index >= DECK_SIZE)
+        {
+            report(pos, token, "Invalid card index '%.*s'.", (int) length, token);
+            return -1;
+        }
+        card_t *card_p = add_empty_card(hand);
+        if (card_p == NULL)
+        {
+            fprintf(stderr, "Failed to add future card to hand.\n");
+            return -1;
+        }
+        add_future_card(fc, index, card_p);
+        return 0;
+    }
+    unsigned value = value_of[(unsigned char) token[0]];
+    unsigned suit = length == 2 ? suit_of[(unsigned char) token[1]] : 0;
+    if (value == 0 || suit == 0)
+    {
+        report(pos, token, "Invalid card '%.*s'.", (int) length, token);
+        return -1;
+    }
+    card_t card = { .value = value, .suit = suit - 1 };
+    size_t n_cards = hand->n_cards;
+    add_card_to(hand, card);
+    return hand->n_cards > n_cards ? 0 : -1;
+}
+
+static deck_t *parse_hand(const char *text, const char *end, future_cards_t *fc,
+                          const input_pos_t *pos)
+/*
+   Parses the hand in the bytes from text to end, in place: cards such as As
+   or 0h, placeholders ?n, and at most one range in square brackets (see
+   range.h) standing for the two hole cards, which come first in the hand.
+   Returns NULL if the hand cannot be built.
+*/
+{
+    deck_t *hand = initialize_deck_in(fc->arena);
+    if (hand == NULL)
+    {
+        return NULL;
+    }
+    const char *open = memchr(text, '[', end - text);
+    const char *after = open != NULL ? take_range(open, end, hand, fc, pos) : NULL;
+    int ok = open == NULL || after != NULL;
+    const char *p = skip_blanks(text, end);
+    while (ok && p < end)
+    {
+        if (p == open)
+        {
+            p = skip_blanks(after, end);
+            continue;
+        }
+        const char *stop = token_end(p, open != NULL && p < open ? open : end);
+        if (*p == '[' || *p == ']')
+        {
+            report(pos, p, "Only one range in square brackets is allowed per hand.");
+            ok = 0;
+        }
+        else
+        {
+            ok = add_token(p, stop, hand, fc, pos) == 0;
+        }
+        p = skip_blanks(stop, end);
+    }
+    if (!ok)
+    {
+        free_deck(hand);
+        return NULL;
+    }
+    return hand;
+}
+
+deck_t * hand_from_string(const char * line, future_cards_t * fc)
+/*
+   Parses one hand, as written on a line of input (see parse_hand). Returns
+   NULL if the hand cannot be built.
+*/
+{
+    input_pos_t pos = { "hand", 1, line };
+    return parse_hand(line, line + strlen(line), fc, &pos);
+}
+
+static int add_hand_from_line(const char *line, const char *end, deck_t ***hands,
+                              size_t *n_hands, future_cards_t *fc, input_pos_t *pos)
+/*
+   Parses the bytes from line to end as one hand and appends it to *hands.
+   Returns 1 if a hand was added, 0 if the line is blank and -1 on error.
+   The array grows by doubling: it is reallocated whenever *n_hands is 0 or
+   a power of two.
+*/
+{
+    pos->start = line;
+    if (skip_blanks(line, end) == end) return 0;
+    deck_t *new_hand = parse_hand(line, end, fc, pos);
+    if (new_hand == NULL)
+    {
+        return -1;
+    }
+    if (new_hand->n_cards < 5)
+    {
+        report(pos, NULL, "Not enough cards in hand.");
+        free_deck(new_hand);
+        return -1;
+    }
+    size_t n = *n_hands;
+    if ((n & (n - 1)) == 0)
+    {
+        size_t size = sizeof(**hands) * (n > 0 ? 2 * n : 1);
+        deck_t **new_hands;
+        if (fc->arena != NULL)
+        {
+            new_hands = arena_realloc(fc->arena, *hands, sizeof(**hands) * n, size);
+        }
+        else
+        {
+            new_hands = realloc(*hands, size);
+        }
+        if (new_hands == NULL)
+        {
+            fprintf(stderr, "Failed to allocate memory for hand. Error: %d\n", errno);
+            free_deck(new_hand);
+            return -1;
+        }
+        *hands = new_hands;
+    }
+    (*hands)[n] = new_hand;
+    ++*n_hands;
+    return 1;
+}
+
+static ssize_t parse_lines(const char *text, size_t length, int at_end, deck_t ***hands,
+                           size_t *n_hands, future_cards_t *fc, input_pos_t *pos)
+/*
+   Adds the hands on the complete lines of the length bytes at text, and on
+   a last unterminated line too if at_end. Returns the number of bytes
+   consumed, or -1 on error.
+*/
+{
+    const char *p = text;
+    const char *end = text + length;
+    while (p < end)
+    {
+        const char *newline = memchr(p, '\n', end - p);
+        if (newline == NULL && !at_end) break;
+        const char *stop = newline != NULL ? newline : end;
+        if (add_hand_from_line(p, stop, hands, n_hands, fc, pos) < 0)
+        {
+            return -1;
+        }
+        ++pos->line;
+        p = newline != NULL ? newline + 1 : end;
+    }
+    return p - text;
+}
+
+static int read_mapped(FILE *f, deck_t ***hands, size_t *n_hands, future_cards_t *fc,
+                       input_pos_t *pos)
+/*
+   Parses f in place through a read-only mapping if it is a regular file
+   that has not been read from yet, and then leaves f at its end. Returns 0
+   on success, -1 on error, or 1 if f cannot be mapped.
+*/
+{
+    struct stat st;
+    int fd = fileno(f);
+    if (fd < 0 || ftell(f) != 0 || fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) ||
+        st.st_size == 0)
+    {
+        return 1;
+    }
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED)
+    {
+        return 1;
+    }
+    madvise(map, st.st_size, MADV_SEQUENTIAL);
+    ssize_t used = parse_lines(map, st.st_size, 1, hands, n_hands, fc, pos);
+    munmap(map, st.st_size);
+    fseek(f, 0, SEEK_END);
+    return used < 0 ? -1 : 0;
+}
+
+static int read_buffered(FILE *f, deck_t ***hands, size_t *n_hands, future_cards_t *fc,
+                         input_pos_t *pos)
+/*
+   Parses f in chunks of INPUT_CHUNK bytes read into one buffer, which only
+   grows for a line longer than it. Returns 0 on success and -1 on error.
+*/
+{
+    size_t capacity = INPUT_CHUNK;
+    size_t have = 0;
+    char *buffer = malloc(capacity);
+    int at_end = 0;
+    while (buffer != NULL && !at_end)
+    {
+        if (have == capacity)
+        {
+            char *bigger = realloc(buffer, 2 * capacity);
+            if (bigger == NULL) break;
+            buffer = bigger;
+            capacity *= 2;
+        }
+        size_t n = fread(buffer + have, 1, capacity - have, f);
+        have += n;
+        at_end = n == 0;
+        ssize_t used = parse_lines(buffer, have, at_end, hands, n_hands, fc, pos);
+        if (used < 0)
+        {
+            free(buffer);
+            return -1;
+        }
+        memmove(buffer, buffer + used, have - used);
+        have -= used;
+    }
+    if (!at_end)
+    {
+        fprintf(stderr, "Failed to allocate memory for input. Error: %d\n", errno);
+        free(buffer);
+        return -1;
+    }
+    free(buffer);
+    if (ferror(f))
+    {
+        fprintf(stderr, "Failed to read %s. Error: %d\n", pos->name, errno);
+        return -1;
+    }
+    return 0;
+}
+
+static deck_t **read_named(FILE *f, const char *name, size_t *n_hands, future_cards_t *fc)
+/* read_input, naming the input name in error messages. */
+{
+    deck_t **hands = NULL;
+    input_pos_t pos = { name, 1, NULL };
+    int status = read_mapped(f, &hands, n_hands, fc, &pos);
+    if (status > 0)
+    {
+        status = read_buffered(f, &hands, n_hands, fc, &pos);
+    }
+    if (status != 0)
+    {
+        free_decks(hands, *n_hands);
+        *n_hands = 0;
+        return NULL;
+    }
+    return hands;
+}
+
+deck_t ** read_input(FILE * f, size_t * n_hands, future_cards_t * fc)
+/*
+   This function reads the input from f. The input file has one hand per line 
+   (a hand is of type deck_t). A deck_t type deck is allocated for each hand
+   and it is placed into an array of pointers to deck_t decks, which is 
+   returned. The number of decks is passed back trough the n_hands pointer.
+   
+   For any future future cards (?0, ?1, ...) in the deck, the add_empty_card is 
+   used to create a placeholder in the hand. The add_future_card function is 
+   used later to make sure the hand is updated correctly when cards are drawn 
+   later. 
+   
+   The code assumes that a poker hand has AT LEAST 5 cards in it. If there are 
+   fewer than 5 cards, a useful error message is printed before exit.
+
+   If fc was created with init_future_cards_in, the hands and the returned
+   array are allocated from fc's arena and are released with it.
+
+   Lines are parsed where they lie, in a mapping of f when it is a regular
+   file and otherwise in a large buffer, without being copied. A malformed
+   hand is reported with its line and column and makes the whole read fail.
+*/
+{
+    return read_named(f, "input", n_hands, fc);
+}
+
+deck_t ** read_input_file(const char * path, size_t * n_hands, future_cards_t * fc)
+/*
+   read_input for the file at path, which error messages name. Returns NULL
+   if the file cannot be opened.
+*/
+{
+    FILE *f = fopen(path, "r");
+    if (f == NULL)
+    {
+        fprintf(stderr, "Failed to open file '%s'. Error: %d\n", path, errno);
+        return NULL;
+    }
+    deck_t **hands = read_named(f, path, n_hands, fc);
+    fclose(f);
+    return hands;
+}
+
+int read_request(FILE * f, deck_t *** hands, size_t * n_hands, future_cards_t * fc)
+/*
+   Reads one request from f: the hands on consecutive lines, ended by a blank
+   line or the end of the input. Blank lines before the first hand are
+   skipped. Returns 1 with the hands in *hands and *n_hands, 0 if the input
+   ended before any hand, or -1 if a hand was malformed; the rest of that
+   request is then skipped so that the next call starts at the following
+   request. Memory is handled as for read_input; errors give the line
+   number within the request.
+*/
+{
+    char *line = NULL;
+    size_t size = 0;
+    ssize_t length;
+    int failed = 0;
+    input_pos_t pos = { "request", 1, NULL };
+
+    *hands = NULL;
+    *n_hands = 0;
+    while ((length = getline(&line, &size, f)) > 0)
+    {
+        const char *end = line + length;
+        if (failed)
+        {
+            if (skip_blanks(line, end) == end) break;
+            continue;
+        }
+        int added = add_hand_from_line(line, end, hands, n_hands, fc, &pos);
+        if (added == 0 && *n_hands > 0) break;
+        if (added < 0) failed = 1;
+        ++pos.line;
+    }
+    free(line);
+    if (failed)
+    {
+        free_decks(*hands, *n_hands);
+        *hands = NULL;
+        *n_hands = 0;
+        return -1;
+    }
+    return *n_hands > 0;
+}
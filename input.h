@@ -6,5 +6,7 @@
 
 deck_t * hand_from_string(const char * str, future_cards_t * fc);
 deck_t ** read_input(FILE * f, size_t * n_hands, future_cards_t * fc);
+deck_t ** read_input_file(const char * path, size_t * n_hands, future_cards_t * fc);
+int read_request(FILE * f, deck_t *** hands, size_t * n_hands, future_cards_t * fc);
 
 #endif
@@ -0,0 +1,226 @@
+/* The batch strength kernel, written with GCC vector extensions. strength.c
+ * includes this file once per instruction set level, inside a
+ * "#pragma GCC target" region, with KERNEL_LANES set to the number of 32-bit
+ * lanes in a vector of that level and KERNEL(name) giving each definition a
+ * name of its own. It therefore has no include guard.
+ *
+ * strength_lanes evaluates KERNEL_LANES hands at once, one per lane, and
+ * gives the same strengths as strength_state_eval. The category and its made
+ * values are selected with masks, from the lowest category up, so no branch
+ * depends on the cards, and the kickers of whichever category won are then
+ * collected in one pass. The highest set bit of a rank mask is read off the
+ * exponent of its conversion to float, so only shifts by constants are
+ * needed.
+ */
+
+/* Every name defined here gets the suffix of the level. */
+#define lanes_t KERNEL(lanes_t)
+#define int_lanes_t KERNEL(int_lanes_t)
+#define float_lanes_t KERNEL(float_lanes_t)
+#define mask_lanes_t KERNEL(mask_lanes_t)
+#define select_lanes KERNEL(select_lanes)
+#define float_bits_lanes KERNEL(float_bits_lanes)
+#define highest_bit_lanes KERNEL(highest_bit_lanes)
+#define highest_value_lanes KERNEL(highest_value_lanes)
+#define popcount_lanes KERNEL(popcount_lanes)
+#define top_values_lanes KERNEL(top_values_lanes)
+#define straight_values_lanes KERNEL(straight_values_lanes)
+#define category_lanes KERNEL(category_lanes)
+#define strength_lanes KERNEL(strength_lanes)
+#define suit_mask_strengths_lanes KERNEL(suit_mask_strengths_lanes)
+#define cardset_strengths_lanes KERNEL(cardset_strengths_lanes)
+
+typedef uint32_t lanes_t __attribute__((vector_size(4 * KERNEL_LANES)));
+typedef int32_t int_lanes_t __attribute__((vector_size(4 * KERNEL_LANES)));
+typedef float float_lanes_t __attribute__((vector_size(4 * KERNEL_LANES)));
+typedef uint16_t mask_lanes_t __attribute__((vector_size(2 * KERNEL_LANES)));
+
+static inline lanes_t select_lanes(lanes_t cond, lanes_t a, lanes_t b)
+/* a where cond is all ones, b where it is 0. */
+{
+  return (cond & a) | (~cond & b);
+}
+
+static inline lanes_t float_bits_lanes(lanes_t m)
+{
+  return (lanes_t) __builtin_convertvector((int_lanes_t) m, float_lanes_t);
+}
+
+static inline lanes_t highest_bit_lanes(lanes_t m)
+/* The highest set bit of each rank mask alone, or 0. */
+{
+  float_lanes_t power = (float_lanes_t) (float_bits_lanes(m) & 0xff800000u);
+  return (lanes_t) __builtin_convertvector(power, int_lanes_t);
+}
+
+static inline lanes_t highest_value_lanes(lanes_t m)
+/* The value of the highest rank in each rank mask, or 0 for an empty one. */
+{
+  return ((float_bits_lanes(m) >> 23) - 125) & (lanes_t) (m != 0);
+}
+
+static inline lanes_t popcount_lanes(lanes_t m)
+{
+  m = m - ((m >> 1) & 0x5555);
+  m = (m & 0x3333) + ((m >> 2) & 0x3333);
+  m = (m + (m >> 4)) & 0x0f0f;
+  return (m + (m >> 8)) & 0x1f;
+}
+
+static inline lanes_t top_values_lanes(lanes_t m)
+/* top_values of each mask. */
+{
+  lanes_t packed = m ^ m;
+  for (int i = 0; i < 5; ++i)
+  {
+    packed = (packed << 4) | highest_value_lanes(m);
+    m &= ~highest_bit_lanes(m);
+  }
+  return packed;
+}
+
+static inline lanes_t straight_values_lanes(lanes_t m)
+/* straight_values of the best straight in each mask, or 0 if it holds
+ * none.
+ */
+{
+  lanes_t runs = m & (m >> 1) & (m >> 2) & (m >> 3) & (m >> 4);
+  lanes_t has_run = (lanes_t) (runs != 0);
+  lanes_t wheel = (lanes_t) ((m & RANK_MASK_WHEEL) == RANK_MASK_WHEEL);
+  lanes_t high = highest_value_lanes(runs) + 4;
+  return select_lanes(has_run, high * 0x11111 - 0x01234,
+                      wheel & (straight_values(5) + (m ^ m)));
+}
+
+static inline lanes_t category_lanes(hand_ranking_t r)
+{
+  lanes_t zero = { 0 };
+  return zero + ((uint32_t) (NOTHING - r) << STRENGTH_CATEGORY_SHIFT);
+}
+
+static inline lanes_t strength_lanes(const lanes_t suits[NUM_SUITS])
+{
+  lanes_t zero = suits[0] ^ suits[0];
+  lanes_t ones = zero, twos = zero, threes = zero, fours = zero + RANK_MASK_ALL;
+  lanes_t flush = zero;
+  for (int s = 0; s < NUM_SUITS; ++s)
+  {
+    threes |= twos & suits[s];
+    twos |= ones & suits[s];
+    ones |= suits[s];
+    fours &= suits[s];
+    flush = select_lanes((lanes_t) (popcount_lanes(suits[s]) >= 5), suits[s], flush);
+  }
+  lanes_t flush_straight = straight_values_lanes(flush);
+  lanes_t straight = straight_values_lanes(ones);
+  lanes_t q = highest_bit_lanes(fours);
+  lanes_t t = highest_bit_lanes(threes);
+  lanes_t pair1 = highest_bit_lanes(twos);
+  lanes_t pair2 = highest_bit_lanes(twos & ~pair1);
+  lanes_t tv = highest_value_lanes(t) * 0x11100;
+  lanes_t pv = highest_value_lanes(pair1) * 0x11000;
+
+  /* res holds the category and made values, kickers the ranks that fill the
+   * remaining places, and drop how many of the five top kickers do not fit.
+   */
+  lanes_t res = category_lanes(NOTHING);
+  lanes_t kickers = ones;
+  lanes_t drop = zero;
+  lanes_t cond = (lanes_t) (twos != 0);
+  res = select_lanes(cond, category_lanes(PAIR) | pv, res);
+  kickers = select_lanes(cond, ones & ~pair1, kickers);
+  drop = select_lanes(cond, zero + 2, drop);
+  cond = (lanes_t) (pair2 != 0);
+  res = select_lanes(cond, category_lanes(TWO_PAIR) | pv |
+                     highest_value_lanes(pair2) * 0x110, res);
+  kickers = select_lanes(cond, ones & ~pair1 & ~pair2, kickers);
+  drop = select_lanes(cond, zero + 4, drop);
+  cond = (lanes_t) (threes != 0);
+  res = select_lanes(cond, category_lanes(THREE_OF_A_KIND) | tv, res);
+  kickers = select_lanes(cond, ones & ~t, kickers);
+  drop = select_lanes(cond, zero + 3, drop);
+  cond = (lanes_t) (straight != 0);
+  res = select_lanes(cond, category_lanes(STRAIGHT) | straight, res);
+  kickers &= ~cond;
+  cond = (lanes_t) (flush != 0);
+  res = select_lanes(cond, category_lanes(FLUSH), res);
+  kickers = select_lanes(cond, flush, kickers);
+  drop &= ~cond;
+  cond = (lanes_t) (threes != 0) & (lanes_t) ((twos & ~t) != 0);
+  res = select_lanes(cond, category_lanes(FULL_HOUSE) | tv |
+                     highest_value_lanes(twos & ~t) * 0x11, res);
+  kickers &= ~cond;
+  cond = (lanes_t) (fours != 0);
+  res = select_lanes(cond, category_lanes(FOUR_OF_A_KIND) |
+                     highest_value_lanes(q) * 0x11110, res);
+  kickers = select_lanes(cond, ones & ~q, kickers);
+  drop = select_lanes(cond, zero + 4, drop);
+  cond = (lanes_t) (flush_straight != 0);
+  res = select_lanes(cond, category_lanes(STRAIGHT_FLUSH) | flush_straight, res);
+  kickers &= ~cond;
+
+  lanes_t kv = top_values_lanes(kickers);
+  kv = select_lanes((lanes_t) (drop == 2), kv >> 8, kv);
+  kv = select_lanes((lanes_t) (drop == 3), kv >> 12, kv);
+  kv = select_lanes((lanes_t) (drop == 4), kv >> 16, kv);
+  return res | kv;
+}
+
+static void suit_mask_strengths_lanes(const uint16_t *const suits[NUM_SUITS], size_t n,
+                                      hand_strength_t *out)
+/* Evaluates n hands laid out structure-of-arrays: suits[s][i] is the 13-bit
+ * rank mask of the cards of suit s in hand i. Writes the strength of hand i
+ * to out[i], as cardset_strength would give it.
+ */
+{
+  for (size_t i = 0; i < n; i += KERNEL_LANES)
+  {
+    size_t k = n - i < KERNEL_LANES ? n - i : KERNEL_LANES;
+    lanes_t lanes[NUM_SUITS];
+    for (int s = 0; s < NUM_SUITS; ++s)
+    {
+      mask_lanes_t m = { 0 };
+      memcpy(&m, suits[s] + i, sizeof(*suits[s]) * k);
+      lanes[s] = __builtin_convertvector(m, lanes_t);
+    }
+    lanes_t res = strength_lanes(lanes);
+    memcpy(out + i, &res, sizeof(*out) * k);
+  }
+}
+
+static void cardset_strengths_lanes(const cardset_t *sets, size_t n, hand_strength_t *out)
+/* Evaluates n card sets in batches, as cardset_strength would each. */
+{
+  for (size_t i = 0; i < n; i += KERNEL_LANES)
+  {
+    size_t k = n - i < KERNEL_LANES ? n - i : KERNEL_LANES;
+    uint32_t masks[NUM_SUITS][KERNEL_LANES] = { { 0 } };
+    for (size_t j = 0; j < k; ++j)
+    {
+      for (int s = 0; s < NUM_SUITS; ++s)
+      {
+        masks[s][j] = cardset_suit(sets[i + j], s);
+      }
+    }
+    lanes_t lanes[NUM_SUITS];
+    memcpy(lanes, masks, sizeof(lanes));
+    lanes_t res = strength_lanes(lanes);
+    memcpy(out + i, &res, sizeof(*out) * k);
+  }
+}
+
+#undef lanes_t
+#undef int_lanes_t
+#undef float_lanes_t
+#undef mask_lanes_t
+#undef select_lanes
+#undef float_bits_lanes
+#undef highest_bit_lanes
+#undef highest_value_lanes
+#undef popcount_lanes
+#undef top_values_lanes
+#undef straight_values_lanes
+#undef category_lanes
+#undef strength_lanes
+#undef suit_mask_strengths_lanes
+#undef cardset_strengths_lanes
@@ -0,0 +1,507 @@
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+#include "arena.h"
+#include "cache.h"
+#include "cards.h"
+#include "cpu.h"
+#include "deck.h"
+#include "enumerate.h"
+#include "future.h"
+#include "input.h"
+#include "pack.h"
+#include "pool.h"
+#include "preflop.h"
+#include "scenario.h"
+#include "shard.h"
+#include "sim.h"
+#include "strength.h"
+
+#define DEFAULT_TRIALS 10000
+
+/* How every scenario is evaluated, as set on the command line. */
+struct settings_tag {
+    unsigned long long n_trials;
+    unsigned n_threads;
+    uint64_t seed;
+    int mode;
+    double tolerance;
+    preflop_table_t *table;
+    result_cache_t *cache;
+    unsigned shard;            /* run only this shard of n_shards, */
+    unsigned n_shards;         /* unless n_shards is 0 */
+    const char *partial_path;  /* where to write a shard's counts, or NULL */
+    unsigned sampling;         /* SIM_STRATIFIED and/or SIM_ANTITHETIC */
+};
+typedef struct settings_tag settings_t;
+
+void usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s [-e | -m] [-p tolerance] [-v methods] [-t threads] [-r seed]\n"
+            "       [-c cache_file] [-f preflop_table] input_file [num_trials]\n", prog);
+    fprintf(stderr, "       %s [options] (-s | -u socket_path) [num_trials]\n", prog);
+    fprintf(stderr, "       %s -k shard/count -r seed [-t threads] [-o partial_file]\n"
+            "       input_file [num_trials]\n", prog);
+    fprintf(stderr, "  -e          enumerate every outcome exactly instead of sampling\n");
+    fprintf(stderr, "  -m          always sample, even when enumerating would be cheaper\n");
+    fprintf(stderr, "  -p tol      sample until every win/tie rate is known to +/- tol (e.g. 0.005)\n");
+    fprintf(stderr, "              with 95%% confidence, running at most num_trials trials\n");
+    fprintf(stderr, "  -v methods  reduce the variance of sampling: s to stratify the first unknown\n");
+    fprintf(stderr, "              card over every remaining card, a to pair antithetic trials,\n");
+    fprintf(stderr, "              or sa for both; the reduction achieved is reported\n");
+    fprintf(stderr, "  -t threads  number of simulation threads (default: one per CPU)\n");
+    fprintf(stderr, "  -r seed     random seed (default: current time)\n");
+    fprintf(stderr, "  -c file     reuse results stored in file, and store new ones there\n");
+    fprintf(stderr, "  -f table    answer two starting hands with an unknown board from a\n");
+    fprintf(stderr, "              table built by preflop-gen\n");
+    fprintf(stderr, "  -s          serve requests from stdin: hands one per line, each request\n");
+    fprintf(stderr, "              ended by a blank line; each answer is followed by one too\n");
+    fprintf(stderr, "  -u path     serve requests from connections to a Unix socket at path\n");
+    fprintf(stderr, "  -k i/n      run only shard i (0 to n-1) of a sampling of num_trials trials\n");
+    fprintf(stderr, "              split into n shards; every shard must use the same seed\n");
+    fprintf(stderr, "  -o file     write the counts to file, for poker-merge to combine\n");
+    fprintf(stderr, "Without -e or -m, outcomes are enumerated exactly when there are no more\n");
+    fprintf(stderr, "of them than num_trials.\n");
+    fprintf(stderr, "A hand may give its two hole cards as a range in square brackets, e.g.\n");
+    fprintf(stderr, "  [QQ+, AKs, AQo:0.5] ?0 ?1 ?2 ?3 ?4\n");
+    fprintf(stderr, "Enumerating such inputs deals every combination of the ranges, weighted.\n");
+    fprintf(stderr, "input_file holds one scenario, one hand per line; blank lines are ignored.\n");
+    fprintf(stderr, "It may also be a scenario pack written by poker-convert from several such\n");
+    fprintf(stderr, "files, whose scenarios are evaluated in turn.\n");
+    fprintf(stderr, "The evaluation kernels suit the processor; set %s to scalar, sse4.2,\n",
+            CPU_LEVEL_ENV);
+    fprintf(stderr, "avx2 or avx512 to choose others.\n");
+}
+
+sim_result_t *evaluate_shard(scenario_t *sc, settings_t *settings, FILE *out)
+/* Samples the selected shard of the scenario and writes its counts to the
+ * partial result file, if one was given. Shards always sample, and skip
+ * the preflop table and the cache, so that their counts can be merged.
+ */
+{
+    sim_result_t *res = simulate_shard(sc, settings->n_trials, settings->n_threads,
+                                       settings->seed, settings->shard, settings->n_shards,
+                                       settings->sampling);
+    if (res == NULL)
+    {
+        return NULL;
+    }
+    if (settings->partial_path != NULL)
+    {
+        partial_result_t part = { scenario_hash(sc), settings->seed, settings->n_trials,
+                                  settings->sampling, settings->n_shards, 1,
+                                  &settings->shard, res };
+        if (write_partial_result(settings->partial_path, &part) != 0)
+        {
+            free_sim_result(res);
+            return NULL;
+        }
+    }
+    fprintf(out, "Shard %u of %u: sampled %llu trials, 95%% confidence +/- %.3f%%\n",
+            settings->shard, settings->n_shards, res->n_trials, 100 * sim_result_half_width(res));
+    print_variance_reduction(out, res);
+    return res;
+}
+
+sim_result_t *evaluate(deck_t **hands, size_t n_hands, future_cards_t *fc,
+                       settings_t *settings, FILE *out)
+/* Runs the exact enumeration or the simulation, as selected by the mode,
+ * unless the preflop table or the cache (either may be NULL) already holds a
+ * good enough result, and prints how the result was obtained to out.
+ */
+{
+    unsigned long long n_trials = settings->n_trials;
+    unsigned n_threads = settings->n_threads;
+    double tolerance = settings->tolerance;
+    sim_result_t *res = NULL;
+    scenario_t *sc = compile_scenario(hands, n_hands, fc);
+    if (sc == NULL)
+    {
+        return NULL;
+    }
+    if (settings->n_shards > 0)
+    {
+        res = evaluate_shard(sc, settings, out);
+        free_scenario(sc);
+        return res;
+    }
+    int exact = 0;
+    if (settings->mode != 'm')
+    {
+        double n_outcomes = count_enumeration(sc);
+        exact = (settings->mode == 'e' || (n_outcomes >= 0 && n_outcomes <= n_trials));
+    }
+    if (settings->table != NULL)
+    {
+        res = preflop_lookup_scenario(settings->table, sc);
+        if (res != NULL && !sim_result_suffices(res, exact, n_trials, tolerance))
+        {
+            free_sim_result(res);
+            res = NULL;
+        }
+    }
+    if (res == NULL && settings->cache != NULL)
+    {
+        res = cache_lookup(settings->cache, sc, exact, n_trials, tolerance);
+    }
+    if (res == NULL)
+    {
+        if (exact)
+        {
+            res = run_enumeration(sc, n_threads);
+        }
+        else if (tolerance > 0)
+        {
+            res = simulate_scenario_until(sc, tolerance, n_trials, n_threads, settings->seed,
+                                          settings->sampling);
+        }
+        else
+        {
+            res = simulate_shard(sc, n_trials, n_threads, settings->seed, 0, 1, settings->sampling);
+        }
+        if (res != NULL && settings->cache != NULL)
+        {
+            cache_store(settings->cache, sc, res);
+        }
+    }
+    free_scenario(sc);
+    if (res == NULL)
+    {
+        return NULL;
+    }
+    if (res->exact)
+    {
+        fprintf(out, "Exact results over %llu outcomes\n", res->n_trials);
+    }
+    else
+    {
+        fprintf(out, "Sampled %llu trials, 95%% confidence +/- %.3f%%\n", res->n_trials,
+                100 * sim_result_half_width(res));
+        print_variance_reduction(out, res);
+    }
+    return res;
+}
+
+int serve(FILE *in, FILE *out, arena_t *arena, settings_t *settings)
+/* Answers every request read from in on out until in ends. All memory of a
+ * request comes from arena, which is reset after each answer, so its block
+ * is reused from one request to the next. An answer that cannot be computed
+ * is a line starting with "Error:". Returns 0 when in ends, or -1 if out
+ * fails.
+ */
+{
+    for (;;)
+    {
+        reset_arena(arena);
+        future_cards_t *fc = init_future_cards_in(arena);
+        deck_t **hands = NULL;
+        size_t n_hands = 0;
+        int status = fc != NULL ? read_request(in, &hands, &n_hands, fc) : -1;
+        if (status == 0)
+        {
+            return 0;
+        }
+        sim_result_t *res = NULL;
+        if (status > 0)
+        {
+            res = evaluate(hands, n_hands, fc, settings, out);
+        }
+        if (res != NULL)
+        {
+            print_sim_result(out, res, hands, fc);
+            free_sim_result(res);
+        }
+        else
+        {
+            fprintf(out, "Error: invalid request\n");
+        }
+        fprintf(out, "\n");
+        if (fflush(out) != 0)
+        {
+            return -1;
+        }
+    }
+}
+
+int serve_socket(const char *path, arena_t *arena, settings_t *settings)
+/* Listens on a Unix socket at path (replacing any file there) and serves
+ * each connection in turn until the client closes it. Only returns on
+ * error.
+ */
+{
+    struct sockaddr_un addr;
+    if (strlen(path) >= sizeof(addr.sun_path))
+    {
+        fprintf(stderr, "Socket path '%s' is too long.\n", path);
+        return -1;
+    }
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0)
+    {
+        fprintf(stderr, "Failed to create socket. Error: %d\n", errno);
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    unlink(path);
+    if (bind(listener, (struct sockaddr *) &addr, sizeof(addr)) != 0 || listen(listener, 16) != 0)
+    {
+        fprintf(stderr, "Failed to listen on '%s'. Error: %d\n", path, errno);
+        close(listener);
+        return -1;
+    }
+    /* A client that goes away mid-answer must not kill the server. */
+    signal(SIGPIPE, SIG_IGN);
+    for (;;)
+    {
+        int conn = accept(listener, NULL, NULL);
+        if (conn < 0)
+        {
+            if (errno == EINTR || errno == ECONNABORTED)
+            {
+                continue;
+            }
+            fprintf(stderr, "Failed to accept connection. Error: %d\n", errno);
+            close(listener);
+            return -1;
+        }
+        int out_fd = dup(conn);
+        FILE *in = fdopen(conn, "r");
+        FILE *out = out_fd >= 0 ? fdopen(out_fd, "w") : NULL;
+        if (in == NULL || out == NULL)
+        {
+            fprintf(stderr, "Failed to open connection. Error: %d\n", errno);
+            if (in != NULL) fclose(in);
+            else close(conn);
+            if (out != NULL) fclose(out);
+            else if (out_fd >= 0) close(out_fd);
+            continue;
+        }
+        serve(in, out, arena, settings);
+        fclose(in);
+        fclose(out);
+    }
+}
+
+int run_pack(const char *path, arena_t *arena, settings_t *settings)
+/* Evaluates every scenario of the scenario pack at path in turn and prints
+ * the results, separated by blank lines. Returns the exit status.
+ */
+{
+    scenario_pack_t *pack = open_scenario_pack(path);
+    if (pack == NULL)
+    {
+        return EXIT_FAILURE;
+    }
+    if (pack->n_scenarios == 0)
+    {
+        fprintf(stderr, "No scenarios in '%s'.\n", path);
+        close_scenario_pack(pack);
+        return EXIT_FAILURE;
+    }
+    if (settings->n_shards > 0 && pack->n_scenarios != 1)
+    {
+        fprintf(stderr, "-k and -o need a scenario pack of one scenario.\n");
+        close_scenario_pack(pack);
+        return EXIT_FAILURE;
+    }
+    int status = EXIT_SUCCESS;
+    for (size_t i = 0; i < pack->n_scenarios; ++i)
+    {
+        reset_arena(arena);
+        if (i > 0)
+        {
+            printf("\n");
+        }
+        future_cards_t *fc = init_future_cards_in(arena);
+        size_t n_hands = 0;
+        deck_t **hands = fc != NULL ? load_pack_scenario(pack, i, &n_hands, fc) : NULL;
+        sim_result_t *res = hands != NULL ? evaluate(hands, n_hands, fc, settings, stdout) : NULL;
+        if (res == NULL)
+        {
+            printf("Error: scenario %zu could not be evaluated\n", i);
+            status = EXIT_FAILURE;
+            continue;
+        }
+        print_sim_result(stdout, res, hands, fc);
+        free_sim_result(res);
+    }
+    close_scenario_pack(pack);
+    return status;
+}
+
+int run_file(const char *path, arena_t *arena, settings_t *settings)
+/* Evaluates the hands in the file at path, or the scenarios if it is a
+ * scenario pack, and prints the result. Returns the exit status.
+ */
+{
+    if (is_scenario_pack(path))
+    {
+        return run_pack(path, arena, settings);
+    }
+    future_cards_t *fc = init_future_cards_in(arena);
+    size_t n_hands = 0;
+    deck_t **hands = fc != NULL ? read_input_file(path, &n_hands, fc) : NULL;
+    if (hands == NULL)
+    {
+        fprintf(stderr, "No hands read from '%s'.\n", path);
+        return EXIT_FAILURE;
+    }
+    sim_result_t *res = evaluate(hands, n_hands, fc, settings, stdout);
+    if (res == NULL)
+    {
+        return EXIT_FAILURE;
+    }
+    print_sim_result(stdout, res, hands, fc);
+    free_sim_result(res);
+    return EXIT_SUCCESS;
+}
+
+int run_server(const char *socket_path, arena_t *arena, settings_t *settings)
+/* Serves requests from stdin, or from the Unix socket at socket_path if it
+ * is not NULL, on a thread pool kept for the life of the server. Returns
+ * the exit status.
+ */
+{
+    unsigned n_threads = settings->n_threads ? settings->n_threads : default_thread_count();
+    if (start_shared_pool(n_threads) != 0)
+    {
+        return EXIT_FAILURE;
+    }
+    int status;
+    if (socket_path != NULL)
+    {
+        status = serve_socket(socket_path, arena, settings);
+    }
+    else
+    {
+        status = serve(stdin, stdout, arena, settings);
+    }
+    stop_shared_pool();
+    return status == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int main(int argc, char **argv)
+{
+    settings_t settings = { DEFAULT_TRIALS, 0, (uint64_t) time(NULL), 0, 0, NULL, NULL, 0, 0, NULL, SIM_PLAIN };
+    const char *cache_path = NULL;
+    const char *table_path = NULL;
+    const char *socket_path = NULL;
+    int serving = 0;
+    int seeded = 0;
+    int opt;
+
+    /* Before any thread can evaluate a hand. */
+    init_strength_tables();
+    while ((opt = getopt(argc, argv, "emp:v:t:r:c:f:su:k:o:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'e':
+            case 'm':
+                settings.mode = opt;
+                break;
+            case 'p':
+                settings.tolerance = strtod(optarg, NULL);
+                break;
+            case 'v':
+                if (strspn(optarg, "sa") != strlen(optarg))
+                {
+                    fprintf(stderr, "Invalid sampling methods '%s'.\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                settings.sampling = (strchr(optarg, 's') ? SIM_STRATIFIED : 0) |
+                                    (strchr(optarg, 'a') ? SIM_ANTITHETIC : 0);
+                break;
+            case 't':
+                settings.n_threads = strtoul(optarg, NULL, 10);
+                break;
+            case 'r':
+                settings.seed = strtoull(optarg, NULL, 10);
+                seeded = 1;
+                break;
+            case 'k':
+                if (sscanf(optarg, "%u/%u", &settings.shard, &settings.n_shards) != 2 ||
+                    settings.shard >= settings.n_shards)
+                {
+                    fprintf(stderr, "Invalid shard '%s'.\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'o':
+                settings.partial_path = optarg;
+                break;
+            case 'c':
+                cache_path = optarg;
+                break;
+            case 'f':
+                table_path = optarg;
+                break;
+            case 's':
+                serving = 1;
+                break;
+            case 'u':
+                serving = 1;
+                socket_path = optarg;
+                break;
+            default:
+                usage(argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+    int n_args = serving ? 0 : 1;
+    if (argc - optind < n_args || argc - optind > n_args + 1)
+    {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    if (settings.partial_path != NULL && settings.n_shards == 0)
+    {
+        settings.n_shards = 1;
+    }
+    if (settings.n_shards > 0 && (serving || settings.tolerance > 0 || settings.mode == 'e'))
+    {
+        fprintf(stderr, "-k and -o run a fixed number of trials of one input file.\n");
+        return EXIT_FAILURE;
+    }
+    if (settings.n_shards > 1 && !seeded)
+    {
+        fprintf(stderr, "Every shard needs the same seed, given with -r.\n");
+        return EXIT_FAILURE;
+    }
+    if (argc - optind == n_args + 1)
+    {
+        settings.n_trials = strtoull(argv[optind + n_args], NULL, 10);
+    }
+
+    arena_t *arena = init_arena(0);
+    int status = EXIT_FAILURE;
+    if (arena != NULL &&
+        (table_path == NULL || (settings.table = open_preflop_table(table_path)) != NULL) &&
+        (cache_path == NULL || (settings.cache = open_result_cache(cache_path)) != NULL))
+    {
+        if (serving)
+        {
+            status = run_server(socket_path, arena, &settings);
+        }
+        else
+        {
+            status = run_file(argv[optind], arena, &settings);
+        }
+    }
+    if (settings.cache != NULL)
+    {
+        print_cache_stats(settings.cache, stderr);
+        close_result_cache(settings.cache);
+    }
+    close_preflop_table(settings.table);
+    free_arena(arena);
+    return status;
+}
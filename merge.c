@@ -0,0 +1,74 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "shard.h"
+#include "sim.h"
+
+/* Combines the partial results written by poker -k ... -o into the
+ * equities of the whole run, and optionally into one partial result file
+ * that can be merged further.
+ */
+
+void usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s [-o merged_file] partial_file...\n", prog);
+    fprintf(stderr, "  -o file     also write the merged counts as one partial result\n");
+}
+
+int main(int argc, char **argv)
+{
+    const char *out_path = NULL;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "o:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'o':
+                out_path = optarg;
+                break;
+            default:
+                usage(argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+    if (optind == argc)
+    {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    partial_result_t *total = read_partial_result(argv[optind]);
+    if (total == NULL)
+    {
+        return EXIT_FAILURE;
+    }
+    for (int i = optind + 1; i < argc; ++i)
+    {
+        partial_result_t *part = read_partial_result(argv[i]);
+        if (part == NULL || merge_partial_result(total, part) != 0)
+        {
+            fprintf(stderr, "Failed to merge '%s'.\n", argv[i]);
+            free_partial_result(part);
+            free_partial_result(total);
+            return EXIT_FAILURE;
+        }
+        free_partial_result(part);
+    }
+    if (total->n_covered < total->n_shards)
+    {
+        fprintf(stderr, "Only %zu of %u shards merged.\n", total->n_covered, total->n_shards);
+    }
+    printf("Merged %zu of %u shards: sampled %llu trials, 95%% confidence +/- %.3f%%\n",
+           total->n_covered, total->n_shards, total->res->n_trials,
+           100 * sim_result_half_width(total->res));
+    print_variance_reduction(stdout, total->res);
+    print_sim_result(stdout, total->res, NULL, NULL);
+    int status = EXIT_SUCCESS;
+    if (out_path != NULL && write_partial_result(out_path, total) != 0)
+    {
+        status = EXIT_FAILURE;
+    }
+    free_partial_result(total);
+    return status;
+}
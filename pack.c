@@ -0,0 +1,427 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "cardset.h"
+#include "pack.h"
+
+struct pack_header_tag {
+  char magic[8];
+  uint32_t version;
+  uint32_t reserved;
+  uint64_t n_scenarios;
+  uint64_t index_offset;
+};
+typedef struct pack_header_tag pack_header_t;
+
+struct pack_scenario_tag {
+  uint32_t n_hands;
+  uint32_t size;  /* bytes of the hands that follow */
+};
+typedef struct pack_scenario_tag pack_scenario_t;
+
+/* A placeholder of a hand being written, and the ?n it stands for. */
+struct slot_card_tag {
+  const card_t *card;
+  unsigned slot;
+};
+typedef struct slot_card_tag slot_card_t;
+
+static int by_card(const void *vp1, const void *vp2)
+{
+  const slot_card_t *a = vp1;
+  const slot_card_t *b = vp2;
+  return a->card < b->card ? -1 : a->card > b->card;
+}
+
+pack_writer_t *open_pack_writer(const char *path)
+/* Starts a scenario pack at path. Returns NULL on error. */
+{
+  pack_writer_t *w = calloc(1, sizeof(*w));
+  if (w == NULL)
+  {
+    fprintf(stderr, "Failed to allocate memory for scenario pack. Error: %d\n", errno);
+    return NULL;
+  }
+  w->path = path;
+  w->f = fopen(path, "wb");
+  if (w->f == NULL)
+  {
+    fprintf(stderr, "Failed to open file '%s'. Error: %d\n", path, errno);
+    free(w);
+    return NULL;
+  }
+  /* The header is written again with the counts by close_pack_writer. */
+  pack_header_t header;
+  memset(&header, 0, sizeof(header));
+  if (fwrite(&header, sizeof(header), 1, w->f) != 1)
+  {
+    fprintf(stderr, "Failed to write file '%s'. Error: %d\n", path, errno);
+    fclose(w->f);
+    free(w);
+    return NULL;
+  }
+  w->offset = sizeof(header);
+  return w;
+}
+
+static int reserve_buffer(pack_writer_t *w, size_t size)
+{
+  if (size <= w->buffer_size) return 0;
+  size_t new_size = w->buffer_size > 0 ? w->buffer_size : 4096;
+  while (new_size < size)
+  {
+    new_size *= 2;
+  }
+  unsigned char *buffer = realloc(w->buffer, new_size);
+  if (buffer == NULL)
+  {
+    fprintf(stderr, "Failed to allocate memory for scenario pack. Error: %d\n", errno);
+    return -1;
+  }
+  w->buffer = buffer;
+  w->buffer_size = new_size;
+  return 0;
+}
+
+static int encode_hand(pack_writer_t *w, size_t *used, deck_t *hand, const range_t *range,
+                       const slot_card_t *unknown, size_t n_unknown)
+/* Appends the encoding of hand to the writer's buffer. Returns 0 on
+ * success.
+ */
+{
+  size_t range_cards = range != NULL ? 2 : 0;
+  if (hand->n_cards - range_cards > PACK_MAX_CARDS)
+  {
+    fprintf(stderr, "A hand of %zu cards is too large for a scenario pack.\n", hand->n_cards);
+    return -1;
+  }
+  if (reserve_buffer(w, *used + 4 + 3 * RANGE_MAX_COMBOS + hand->n_cards) != 0)
+  {
+    return -1;
+  }
+  unsigned char *p = w->buffer + *used;
+  *p++ = hand->n_cards - range_cards;
+  if (range != NULL)
+  {
+    *p++ = PACK_RANGE;
+    *p++ = range->n_combos & 0xff;
+    *p++ = range->n_combos >> 8;
+    for (size_t c = 0; c < range->n_combos; ++c)
+    {
+      *p++ = __builtin_ctzll(range->combos[c]);
+      *p++ = 63 - __builtin_clzll(range->combos[c]);
+      *p++ = range->weights[c];
+    }
+  }
+  for (size_t k = 0; k < hand->n_cards; ++k)
+  {
+    const card_t *card = hand->cards[k];
+    if (card->value != 0)
+    {
+      *p++ = card_to_num(*card);
+      continue;
+    }
+    slot_card_t key = { card, 0 };
+    const slot_card_t *found = bsearch(&key, unknown, n_unknown, sizeof(*unknown), by_card);
+    if (found != NULL)
+    {
+      *p++ = PACK_UNKNOWN + found->slot;
+    }
+    else if (range_cards > 0)
+    {
+      --range_cards;  /* stands for a hole card from the range */
+    }
+    else
+    {
+      fprintf(stderr, "A hand holds an unknown card that is no ?n.\n");
+      return -1;
+    }
+  }
+  *used = p - w->buffer;
+  return 0;
+}
+
+int write_pack_scenario(pack_writer_t *w, deck_t **hands, size_t n_hands, future_cards_t *fc)
+/* Appends the scenario of hands, with the placeholders and ranges in fc
+ * (as set up by read_input), to the pack. Returns 0 on success and -1 on
+ * error.
+ */
+{
+  size_t n_unknown = 0;
+  for (size_t s = 0; s < fc->n_decks; ++s)
+  {
+    n_unknown += fc->decks[s].n_cards;
+  }
+  slot_card_t *unknown = malloc(sizeof(*unknown) * (n_unknown + 1));
+  uint64_t *offsets = realloc(w->offsets, sizeof(*offsets) * (w->n_scenarios + 1));
+  if (offsets != NULL)
+  {
+    w->offsets = offsets;
+  }
+  if (unknown == NULL || offsets == NULL)
+  {
+    fprintf(stderr, "Failed to allocate memory for scenario pack. Error: %d\n", errno);
+    free(unknown);
+    return -1;
+  }
+  size_t k = 0;
+  for (size_t s = 0; s < fc->n_decks; ++s)
+  {
+    for (size_t j = 0; j < fc->decks[s].n_cards; ++j)
+    {
+      unknown[k].card = fc->decks[s].cards[j];
+      unknown[k++].slot = s;
+    }
+  }
+  qsort(unknown, n_unknown, sizeof(*unknown), by_card);
+  size_t used = 0;
+  int ok = 1;
+  for (size_t h = 0; h < n_hands && ok; ++h)
+  {
+    ok = encode_hand(w, &used, hands[h], range_of_hand(fc, hands[h]), unknown, n_unknown) == 0;
+  }
+  free(unknown);
+  if (!ok) return -1;
+  if (n_hands > UINT32_MAX || used > UINT32_MAX)
+  {
+    fprintf(stderr, "Scenario of %zu hands is too large for a scenario pack.\n", n_hands);
+    return -1;
+  }
+  pack_scenario_t header = { n_hands, used };
+  if (fwrite(&header, sizeof(header), 1, w->f) != 1 || fwrite(w->buffer, 1, used, w->f) != used)
+  {
+    fprintf(stderr, "Failed to write file '%s'. Error: %d\n", w->path, errno);
+    return -1;
+  }
+  w->offsets[w->n_scenarios++] = w->offset;
+  w->offset += sizeof(header) + used;
+  return 0;
+}
+
+int close_pack_writer(pack_writer_t *w)
+/* Writes the index and header and closes the pack. Returns 0 on success and
+ * -1 on error.
+ */
+{
+  static const char padding[sizeof(uint64_t)];
+  size_t n_padding = -w->offset % sizeof(uint64_t);
+  pack_header_t header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, PACK_MAGIC, sizeof(header.magic));
+  header.version = PACK_VERSION;
+  header.n_scenarios = w->n_scenarios;
+  header.index_offset = w->offset + n_padding;
+  int ok = fwrite(padding, 1, n_padding, w->f) == n_padding &&
+           (w->n_scenarios == 0 ||
+            fwrite(w->offsets, sizeof(*w->offsets), w->n_scenarios, w->f) == w->n_scenarios) &&
+           fseek(w->f, 0, SEEK_SET) == 0 &&
+           fwrite(&header, sizeof(header), 1, w->f) == 1;
+  if (fclose(w->f) != 0) ok = 0;
+  if (!ok)
+  {
+    fprintf(stderr, "Failed to write file '%s'. Error: %d\n", w->path, errno);
+  }
+  free(w->offsets);
+  free(w->buffer);
+  free(w);
+  return ok ? 0 : -1;
+}
+
+int is_scenario_pack(const char *path)
+/* Returns 1 if path is a regular file that starts like a scenario pack.
+ * Anything else, such as a pipe, is left unread.
+ */
+{
+  struct stat st;
+  if (stat(path, &st) != 0 || !S_ISREG(st.st_mode)) return 0;
+  char magic[sizeof(PACK_MAGIC) - 1];
+  FILE *f = fopen(path, "rb");
+  if (f == NULL) return 0;
+  int is_pack = fread(magic, sizeof(magic), 1, f) == 1 &&
+                memcmp(magic, PACK_MAGIC, sizeof(magic)) == 0;
+  fclose(f);
+  return is_pack;
+}
+
+scenario_pack_t *open_scenario_pack(const char *path)
+/* Maps a scenario pack written by close_pack_writer. Returns NULL on
+ * error.
+ */
+{
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+  {
+    fprintf(stderr, "Failed to open file '%s'. Error: %d\n", path, errno);
+    return NULL;
+  }
+  struct stat st;
+  void *map = MAP_FAILED;
+  size_t size = 0;
+  if (fstat(fd, &st) == 0 && (size_t) st.st_size >= sizeof(pack_header_t))
+  {
+    size = st.st_size;
+    map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  }
+  close(fd);
+  const pack_header_t *header = map;
+  if (map == MAP_FAILED || memcmp(header->magic, PACK_MAGIC, sizeof(header->magic)) != 0 ||
+      header->version != PACK_VERSION || header->index_offset < sizeof(*header) ||
+      header->index_offset % sizeof(uint64_t) != 0 || header->index_offset > size ||
+      header->n_scenarios > (size - header->index_offset) / sizeof(uint64_t))
+  {
+    fprintf(stderr, "'%s' is not a scenario pack of version %d.\n", path, PACK_VERSION);
+    if (map != MAP_FAILED) munmap(map, size);
+    return NULL;
+  }
+  scenario_pack_t *pack = malloc(sizeof(*pack));
+  if (pack == NULL)
+  {
+    fprintf(stderr, "Failed to allocate memory for scenario pack. Error: %d\n", errno);
+    munmap(map, size);
+    return NULL;
+  }
+  madvise(map, size, MADV_SEQUENTIAL);
+  pack->map = map;
+  pack->map_size = size;
+  pack->n_scenarios = header->n_scenarios;
+  pack->index_offset = header->index_offset;
+  pack->offsets = (const uint64_t *) ((const char *) map + header->index_offset);
+  return pack;
+}
+
+static int load_range(const unsigned char **at, const unsigned char *end, deck_t *hand,
+                      future_cards_t *fc)
+/* Decodes the range at *at, gives hand its two placeholder hole cards and
+ * moves *at past the range. Returns 0 on success.
+ */
+{
+  const unsigned char *p = *at;
+  if (end - p < 3) return -1;
+  size_t n = p[1] | p[2] << 8;
+  p += 3;
+  if (n == 0 || n > RANGE_MAX_COMBOS || (size_t) (end - p) < 3 * n) return -1;
+  range_t *range = init_range(fc->arena);
+  if (range == NULL) return -1;
+  for (size_t c = 0; c < n; ++c, p += 3)
+  {
+    if (p[0] >= DECK_SIZE || p[1] >= DECK_SIZE || p[0] == p[1] || p[2] == 0)
+    {
+      free_range(range);
+      return -1;
+    }
+    range->combos[c] = cardset_from_num(p[0]) | cardset_from_num(p[1]);
+    range->weights[c] = p[2];
+  }
+  range->n_combos = n;
+  if (add_empty_card(hand) == NULL || add_empty_card(hand) == NULL)
+  {
+    free_range(range);
+    return -1;
+  }
+  if (add_range(fc, hand, range) != 0) return -1;
+  *at = p;
+  return 0;
+}
+
+static deck_t *load_hand(const unsigned char **at, const unsigned char *end, future_cards_t *fc)
+/* Builds the hand encoded at *at and moves *at past it. Returns NULL if the
+ * encoding is invalid.
+ */
+{
+  const unsigned char *p = *at;
+  if (p == end) return NULL;
+  size_t n = *p++;
+  deck_t *hand = initialize_deck_in(fc->arena);
+  if (hand == NULL) return NULL;
+  int ok = 1;
+  if (p < end && *p == PACK_RANGE)
+  {
+    ok = load_range(&p, end, hand, fc) == 0;
+  }
+  size_t first = hand->n_cards;
+  ok = ok && n <= (size_t) (end - p) && add_empty_cards(hand, n) == 0;
+  for (size_t k = 0; ok && k < n; ++k)
+  {
+    unsigned code = p[k];
+    card_t *card = hand->cards[first + k];
+    if (code < DECK_SIZE)
+    {
+      *card = card_from_num(code);
+    }
+    else if (code >= PACK_UNKNOWN && code < PACK_UNKNOWN + DECK_SIZE)
+    {
+      add_future_card(fc, code - PACK_UNKNOWN, card);
+    }
+    else
+    {
+      ok = 0;
+    }
+  }
+  if (!ok)
+  {
+    free_deck(hand);
+    return NULL;
+  }
+  *at = p + n;
+  return hand;
+}
+
+deck_t **load_pack_scenario(const scenario_pack_t *pack, size_t i, size_t *n_hands,
+                            future_cards_t *fc)
+/* Builds the hands of scenario i of pack, with their placeholders and
+ * ranges in fc, as read_input would from the text the scenario was
+ * converted from. Memory is handled as for read_input. Returns NULL on
+ * error.
+ */
+{
+  const unsigned char *base = pack->map;
+  pack_scenario_t header;
+  uint64_t offset = i < pack->n_scenarios ? pack->offsets[i] : 0;
+  int ok = offset >= sizeof(pack_header_t) &&
+           offset <= pack->index_offset - sizeof(header);
+  if (ok)
+  {
+    memcpy(&header, base + offset, sizeof(header));
+    ok = header.size <= pack->index_offset - offset - sizeof(header) &&
+         header.n_hands > 0 && header.n_hands <= header.size;
+  }
+  if (!ok)
+  {
+    fprintf(stderr, "Scenario %zu of the scenario pack is corrupt.\n", i);
+    return NULL;
+  }
+  size_t size = sizeof(deck_t *) * header.n_hands;
+  deck_t **hands = fc->arena != NULL ? arena_alloc(fc->arena, size) : malloc(size);
+  if (hands == NULL)
+  {
+    fprintf(stderr, "Failed to allocate memory for hands. Error: %d\n", errno);
+    return NULL;
+  }
+  const unsigned char *p = base + offset + sizeof(header);
+  const unsigned char *end = p + header.size;
+  size_t h = 0;
+  while (h < header.n_hands && (hands[h] = load_hand(&p, end, fc)) != NULL)
+  {
+    ++h;
+  }
+  if (h < header.n_hands || p != end)
+  {
+    fprintf(stderr, "Scenario %zu of the scenario pack is corrupt.\n", i);
+    if (fc->arena == NULL) free_decks(hands, h);
+    return NULL;
+  }
+  *n_hands = h;
+  return hands;
+}
+
+void close_scenario_pack(scenario_pack_t *pack)
+{
+  if (pack == NULL) return;
+  munmap(pack->map, pack->map_size);
+  free(pack);
+}
@@ -0,0 +1,56 @@
+#ifndef PACK_H
+#define PACK_H
+#include <stdint.h>
+#include <stdio.h>
+#include "deck.h"
+#include "future.h"
+
+/* A scenario pack: many scenarios (the hands of one input) in a compact
+ * binary file that is loaded without tokenising, as written by
+ * poker-convert.
+ *
+ * The file is a header, the scenarios one after another, and an index of
+ * the offset of every scenario, for random access. A scenario is its
+ * number of hands and size in bytes, followed by each hand: a count byte,
+ * an optional range, and that many card codes. A card code is the card's
+ * card_to_num index, or PACK_UNKNOWN + n for the placeholder ?n. A range is
+ * PACK_RANGE, its number of combinations in two bytes (low byte first),
+ * and three bytes per combination: the card_to_num indices of its two
+ * cards and its weight in units of 1/RANGE_WEIGHT_UNIT. The header, the
+ * scenario headers and the index are in the host's byte order.
+ */
+#define PACK_MAGIC "PKRSCENS"
+#define PACK_VERSION 1
+#define PACK_UNKNOWN 64
+#define PACK_RANGE 0xff
+#define PACK_MAX_CARDS 255
+
+struct pack_writer_tag {
+  FILE *f;
+  const char *path;
+  uint64_t offset;          /* bytes written so far */
+  uint64_t *offsets;        /* where each scenario written so far starts */
+  size_t n_scenarios;
+  unsigned char *buffer;    /* the encoding of the scenario being written */
+  size_t buffer_size;
+};
+typedef struct pack_writer_tag pack_writer_t;
+
+struct scenario_pack_tag {
+  void *map;
+  size_t map_size;
+  size_t n_scenarios;
+  const uint64_t *offsets;  /* [scenario] */
+  uint64_t index_offset;    /* where the scenarios end */
+};
+typedef struct scenario_pack_tag scenario_pack_t;
+
+pack_writer_t *open_pack_writer(const char *path);
+int write_pack_scenario(pack_writer_t *w, deck_t **hands, size_t n_hands, future_cards_t *fc);
+int close_pack_writer(pack_writer_t *w);
+int is_scenario_pack(const char *path);
+scenario_pack_t *open_scenario_pack(const char *path);
+deck_t **load_pack_scenario(const scenario_pack_t *pack, size_t i, size_t *n_hands,
+                            future_cards_t *fc);
+void close_scenario_pack(scenario_pack_t *pack);
+#endif
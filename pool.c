@@ -0,0 +1,137 @@
+#include <errno.h>
+#include <stdio.h>
+#include "pool.h"
+
+static thread_pool_t *shared_pool = NULL;
+
+static void *pool_thread(void *arg)
+{
+  thread_pool_t *pool = arg;
+  pthread_mutex_lock(&pool->lock);
+  for (;;)
+  {
+    while (!pool->stopping && pool->next_job >= pool->n_jobs)
+    {
+      pthread_cond_wait(&pool->work, &pool->lock);
+    }
+    if (pool->stopping) break;
+    unsigned job = pool->next_job++;
+    pthread_mutex_unlock(&pool->lock);
+    pool->fn(pool->args + job * pool->stride);
+    pthread_mutex_lock(&pool->lock);
+    if (++pool->n_finished == pool->n_jobs) pthread_cond_signal(&pool->done);
+  }
+  pthread_mutex_unlock(&pool->lock);
+  return NULL;
+}
+
+static void free_pool(thread_pool_t *pool)
+{
+  pthread_mutex_lock(&pool->lock);
+  pool->stopping = 1;
+  pthread_cond_broadcast(&pool->work);
+  pthread_mutex_unlock(&pool->lock);
+  for (unsigned i = 0; i < pool->n_threads; ++i)
+  {
+    pthread_join(pool->threads[i], NULL);
+  }
+  pthread_mutex_destroy(&pool->submit);
+  pthread_mutex_destroy(&pool->lock);
+  pthread_cond_destroy(&pool->work);
+  pthread_cond_destroy(&pool->done);
+  free(pool->threads);
+  free(pool);
+}
+
+int start_shared_pool(unsigned n_threads)
+/* Starts the shared pool with n_threads threads. Returns 0 on success. */
+{
+  if (shared_pool != NULL) stop_shared_pool();
+  thread_pool_t *pool = calloc(1, sizeof(*pool));
+  pthread_t *threads = calloc(n_threads > 0 ? n_threads : 1, sizeof(*threads));
+  if (pool == NULL || threads == NULL)
+  {
+    fprintf(stderr, "Failed to allocate memory for thread pool. Error: %d\n", errno);
+    free(pool);
+    free(threads);
+    return -1;
+  }
+  pool->threads = threads;
+  pthread_mutex_init(&pool->submit, NULL);
+  pthread_mutex_init(&pool->lock, NULL);
+  pthread_cond_init(&pool->work, NULL);
+  pthread_cond_init(&pool->done, NULL);
+  for (unsigned i = 0; i < n_threads; ++i)
+  {
+    if (pthread_create(&pool->threads[i], NULL, pool_thread, pool) != 0)
+    {
+      fprintf(stderr, "Failed to start pool thread.\n");
+      free_pool(pool);
+      return -1;
+    }
+    ++pool->n_threads;
+  }
+  shared_pool = pool;
+  return 0;
+}
+
+void stop_shared_pool(void)
+{
+  if (shared_pool == NULL) return;
+  free_pool(shared_pool);
+  shared_pool = NULL;
+}
+
+static int run_threads(pool_job_fn fn, char *args, size_t stride, unsigned n_jobs)
+{
+  pthread_t *threads = calloc(n_jobs > 0 ? n_jobs : 1, sizeof(*threads));
+  if (threads == NULL)
+  {
+    fprintf(stderr, "Failed to allocate memory for threads. Error: %d\n", errno);
+    return -1;
+  }
+  unsigned n_started = 0;
+  while (n_started < n_jobs)
+  {
+    if (pthread_create(&threads[n_started], NULL, fn, args + n_started * stride) != 0)
+    {
+      fprintf(stderr, "Failed to start thread.\n");
+      break;
+    }
+    ++n_started;
+  }
+  for (unsigned i = 0; i < n_started; ++i)
+  {
+    pthread_join(threads[i], NULL);
+  }
+  free(threads);
+  return n_started == n_jobs ? 0 : -1;
+}
+
+int run_parallel(pool_job_fn fn, void *args, size_t stride, unsigned n_jobs)
+/* Calls fn on n_jobs arguments, the i-th at args + i * stride, in parallel
+ * and returns once every call has returned. Uses the shared pool if one
+ * has been started. Returns 0 on success, or -1 if some jobs could not be
+ * started (the others have still finished).
+ */
+{
+  thread_pool_t *pool = shared_pool;
+  if (pool == NULL || pool->n_threads == 0) return run_threads(fn, args, stride, n_jobs);
+  pthread_mutex_lock(&pool->submit);
+  pthread_mutex_lock(&pool->lock);
+  pool->fn = fn;
+  pool->args = args;
+  pool->stride = stride;
+  pool->n_jobs = n_jobs;
+  pool->next_job = 0;
+  pool->n_finished = 0;
+  pthread_cond_broadcast(&pool->work);
+  while (pool->n_finished < n_jobs)
+  {
+    pthread_cond_wait(&pool->done, &pool->lock);
+  }
+  pool->n_jobs = 0;
+  pthread_mutex_unlock(&pool->lock);
+  pthread_mutex_unlock(&pool->submit);
+  return 0;
+}
@@ -0,0 +1,34 @@
+#ifndef POOL_H
+#define POOL_H
+#include <pthread.h>
+#include <stdlib.h>
+
+/* A fixed set of worker threads that run batches of jobs. A long-running
+ * process starts the shared pool once and every simulation or enumeration
+ * then hands its per-thread work to it instead of creating and joining
+ * threads of its own. Without a shared pool, run_parallel creates one
+ * thread per job as before.
+ */
+typedef void *(*pool_job_fn)(void *);
+
+struct thread_pool_tag {
+  pthread_t *threads;
+  unsigned n_threads;
+  pthread_mutex_t submit;   /* held by the caller of run_parallel */
+  pthread_mutex_t lock;     /* protects everything below */
+  pthread_cond_t work;
+  pthread_cond_t done;
+  pool_job_fn fn;
+  char *args;
+  size_t stride;
+  unsigned n_jobs;
+  unsigned next_job;
+  unsigned n_finished;
+  int stopping;
+};
+typedef struct thread_pool_tag thread_pool_t;
+
+int start_shared_pool(unsigned n_threads);
+void stop_shared_pool(void);
+int run_parallel(pool_job_fn fn, void *args, size_t stride, unsigned n_jobs);
+#endif
@@ -0,0 +1,195 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include "enumerate.h"
+#include "preflop.h"
+#include "scenario.h"
+#include "sim.h"
+#include "suitperm.h"
+
+/* Builds the preflop equity table read by poker -f: every starting-hand
+ * class against every other starting hand, and against a random hand.
+ */
+
+void usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s [-m trials] [-t threads] [-r seed] output_file\n", prog);
+    fprintf(stderr, "  -m trials   sample each matchup with this many trials instead of\n");
+    fprintf(stderr, "              enumerating its %d board cards exactly\n", PREFLOP_BOARD);
+    fprintf(stderr, "  -t threads  number of threads (default: one per CPU)\n");
+    fprintf(stderr, "  -r seed     random seed for -m (default: current time)\n");
+}
+
+uint64_t board_outcomes(void)
+/* The number of boards left once two hands are dealt. */
+{
+    uint64_t n = 1;
+    for (unsigned k = 0; k < PREFLOP_BOARD; ++k)
+    {
+        n = n * (DECK_SIZE - 4 - k) / (k + 1);
+    }
+    return n;
+}
+
+int evaluate_matchup(cardset_t hand, cardset_t other, unsigned long long n_trials,
+                     unsigned n_threads, uint64_t seed, preflop_entry_t *entry)
+/* Fills in entry for hand against other, by exact enumeration if n_trials
+ * is 0. Returns 0 on success.
+ */
+{
+    scenario_t *sc = init_scenario(2, PREFLOP_BOARD);
+    if (sc == NULL)
+    {
+        return -1;
+    }
+    sc->known[0] = hand;
+    sc->known[1] = other;
+    sc->dead = hand | other;
+    for (size_t s = 0; s < PREFLOP_BOARD; ++s)
+    {
+        sc->uses[s] = 1;
+        sc->uses[PREFLOP_BOARD + s] = 1;
+    }
+    sim_result_t *res;
+    if (n_trials == 0)
+    {
+        res = run_enumeration(sc, n_threads);
+    }
+    else
+    {
+        res = simulate_scenario(sc, n_trials, n_threads, seed);
+    }
+    free_scenario(sc);
+    if (res == NULL)
+    {
+        return -1;
+    }
+    entry->wins = res->wins[0];
+    entry->ties = res->ties[0];
+    free_sim_result(res);
+    return 0;
+}
+
+int fill_class(unsigned cls, unsigned long long n_trials, unsigned n_threads, uint64_t seed,
+               preflop_entry_t *row, preflop_random_t *vs_random)
+/* Fills in the row of a class and its result against a random hand.
+ * Opponents that a suit relabelling fixing the class's hand maps onto a
+ * smaller opponent copy that opponent's entry instead of being evaluated.
+ */
+{
+    cardset_t hand = preflop_class_hand(cls);
+    suit_group_t stab = suit_stabiliser(&hand, 1, SUIT_GROUP_ALL);
+    uint64_t per_matchup = n_trials > 0 ? n_trials : board_outcomes();
+    unsigned n_evaluated = 0;
+    vs_random->n_trials = 0;
+    vs_random->wins = 0;
+    vs_random->ties = 0;
+    for (unsigned hi = 1; hi < DECK_SIZE; ++hi)
+    {
+        for (unsigned lo = 0; lo < hi; ++lo)
+        {
+            cardset_t other = cardset_from_num(hi) | cardset_from_num(lo);
+            preflop_entry_t *e = &row[preflop_combo_index(other)];
+            e->wins = 0;
+            e->ties = 0;
+            if (other & hand)
+            {
+                continue;
+            }
+            suit_group_t fixed;
+            unsigned orbit;
+            if (suit_orbit_leader(other, stab, &fixed, &orbit))
+            {
+                if (evaluate_matchup(hand, other, n_trials, n_threads, seed, e) != 0)
+                {
+                    return -1;
+                }
+                ++seed;
+                ++n_evaluated;
+            }
+            else
+            {
+                cardset_t smallest = other;
+                for (unsigned p = 0; p < N_SUIT_PERMS; ++p)
+                {
+                    if (!(stab & ((suit_group_t) 1 << p))) continue;
+                    cardset_t image = permute_suits(other, p);
+                    if (image < smallest) smallest = image;
+                }
+                *e = row[preflop_combo_index(smallest)];
+            }
+            vs_random->n_trials += per_matchup;
+            vs_random->wins += e->wins;
+            vs_random->ties += e->ties;
+        }
+    }
+    char name[4];
+    preflop_class_name(cls, name);
+    fprintf(stderr, "%-3s %4u matchups evaluated, %5.2f%% vs random\n", name, n_evaluated,
+            100.0 * (vs_random->wins + vs_random->ties / 2.0) / vs_random->n_trials);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned long long n_trials = 0;
+    unsigned n_threads = 0;
+    uint64_t seed = (uint64_t) time(NULL);
+    int opt;
+
+    while ((opt = getopt(argc, argv, "m:t:r:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'm':
+                n_trials = strtoull(optarg, NULL, 10);
+                break;
+            case 't':
+                n_threads = strtoul(optarg, NULL, 10);
+                break;
+            case 'r':
+                seed = strtoull(optarg, NULL, 10);
+                break;
+            default:
+                usage(argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+    if (argc - optind != 1)
+    {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    preflop_entry_t *matchups = calloc((size_t) PREFLOP_CLASSES * PREFLOP_COMBOS,
+                                       sizeof(*matchups));
+    preflop_random_t *vs_random = calloc(PREFLOP_CLASSES, sizeof(*vs_random));
+    if (matchups == NULL || vs_random == NULL)
+    {
+        fprintf(stderr, "Failed to allocate memory for preflop table. Error: %d\n", errno);
+        free(matchups);
+        free(vs_random);
+        return EXIT_FAILURE;
+    }
+    int status = EXIT_SUCCESS;
+    for (unsigned cls = 0; cls < PREFLOP_CLASSES && status == EXIT_SUCCESS; ++cls)
+    {
+        if (fill_class(cls, n_trials, n_threads, seed + cls * PREFLOP_COMBOS,
+                       &matchups[cls * PREFLOP_COMBOS], &vs_random[cls]) != 0)
+        {
+            status = EXIT_FAILURE;
+        }
+    }
+    if (status == EXIT_SUCCESS &&
+        write_preflop_table(argv[optind], n_trials == 0,
+                            n_trials > 0 ? n_trials : board_outcomes(),
+                            matchups, vs_random) != 0)
+    {
+        status = EXIT_FAILURE;
+    }
+    free(matchups);
+    free(vs_random);
+    return status;
+}
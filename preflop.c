@@ -0,0 +1,282 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "preflop.h"
+#include "suitperm.h"
+
+struct preflop_header_tag {
+  char magic[8];
+  uint32_t version;
+  uint32_t exact;
+  uint64_t n_trials;
+  uint32_t n_classes;
+  uint32_t n_combos;
+};
+typedef struct preflop_header_tag preflop_header_t;
+
+#define N_MATCHUPS ((size_t) PREFLOP_CLASSES * PREFLOP_COMBOS)
+#define TABLE_SIZE (sizeof(preflop_header_t) + N_MATCHUPS * sizeof(preflop_entry_t) + \
+                    PREFLOP_CLASSES * sizeof(preflop_random_t))
+
+static int is_two_cards(cardset_t hand)
+{
+  return cardset_size(hand) == 2 && (hand & ~CARDSET_FULL) == 0;
+}
+
+unsigned preflop_combo_index(cardset_t hand)
+/* Numbers the two-card sets 0..1325 in increasing order of their bits. */
+{
+  unsigned lo = __builtin_ctzll(hand);
+  unsigned hi = 63 - __builtin_clzll(hand);
+  return hi * (hi - 1) / 2 + lo;
+}
+
+static unsigned pair_index(unsigned hi, unsigned lo)
+/* Numbers the rank pairs hi > lo 0..77. */
+{
+  return hi * (hi - 1) / 2 + lo;
+}
+
+unsigned preflop_class(cardset_t hand, unsigned char to[NUM_SUITS])
+/* Returns the class of a two-card hand, and fills in the suit relabelling
+ * that maps the hand onto preflop_class_hand of that class.
+ */
+{
+  unsigned a = 63 - __builtin_clzll(hand);
+  unsigned b = __builtin_ctzll(hand);
+  unsigned rank_a = a % 13;
+  unsigned rank_b = b % 13;
+  if (rank_b > rank_a)
+  {
+    unsigned t = a;
+    a = b;
+    b = t;
+    t = rank_a;
+    rank_a = rank_b;
+    rank_b = t;
+  }
+  unsigned suit_a = a / 13;
+  unsigned suit_b = b / 13;
+  unsigned next = 0;
+  for (unsigned s = 0; s < NUM_SUITS; ++s)
+  {
+    to[s] = NUM_SUITS;
+  }
+  to[suit_a] = next++;
+  if (suit_b != suit_a) to[suit_b] = next++;
+  for (unsigned s = 0; s < NUM_SUITS; ++s)
+  {
+    if (to[s] == NUM_SUITS) to[s] = next++;
+  }
+  if (rank_a == rank_b) return rank_a;
+  unsigned base = suit_a == suit_b ? 13 : 13 + 78;
+  return base + pair_index(rank_a, rank_b);
+}
+
+cardset_t preflop_class_hand(unsigned cls)
+/* Returns the representative hand of a class. */
+{
+  if (cls < 13)
+  {
+    return cardset_from_num(SPADES * 13 + cls) | cardset_from_num(HEARTS * 13 + cls);
+  }
+  int suited = cls < 13 + 78;
+  unsigned index = cls - (suited ? 13 : 13 + 78);
+  unsigned hi = 1;
+  while (pair_index(hi + 1, 0) <= index)
+  {
+    ++hi;
+  }
+  unsigned lo = index - pair_index(hi, 0);
+  return cardset_from_num(SPADES * 13 + hi) |
+         cardset_from_num((suited ? SPADES : HEARTS) * 13 + lo);
+}
+
+void preflop_class_name(unsigned cls, char name[4])
+/* Writes the usual name of a class ("AA", "AKs", "72o") into name. */
+{
+  cardset_t hand = preflop_class_hand(cls);
+  card_t hi = card_from_num(63 - __builtin_clzll(hand));
+  card_t lo = card_from_num(__builtin_ctzll(hand));
+  if (lo.value > hi.value)
+  {
+    card_t t = hi;
+    hi = lo;
+    lo = t;
+  }
+  name[0] = value_letter(hi);
+  name[1] = value_letter(lo);
+  name[2] = cls < 13 ? '\0' : cls < 13 + 78 ? 's' : 'o';
+  name[3] = '\0';
+}
+
+int write_preflop_table(const char *path, int exact, uint64_t n_trials,
+                        const preflop_entry_t *matchups, const preflop_random_t *vs_random)
+/* Writes a table file. Returns 0 on success and -1 on error. */
+{
+  FILE *f = fopen(path, "wb");
+  if (f == NULL)
+  {
+    fprintf(stderr, "Failed to open file '%s'. Error: %d\n", path, errno);
+    return -1;
+  }
+  preflop_header_t header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, PREFLOP_MAGIC, sizeof(header.magic));
+  header.version = PREFLOP_VERSION;
+  header.exact = exact;
+  header.n_trials = n_trials;
+  header.n_classes = PREFLOP_CLASSES;
+  header.n_combos = PREFLOP_COMBOS;
+  int ok = fwrite(&header, sizeof(header), 1, f) == 1 &&
+           fwrite(matchups, sizeof(*matchups), N_MATCHUPS, f) == N_MATCHUPS &&
+           fwrite(vs_random, sizeof(*vs_random), PREFLOP_CLASSES, f) == PREFLOP_CLASSES;
+  if (fclose(f) != 0) ok = 0;
+  if (!ok)
+  {
+    fprintf(stderr, "Failed to write file '%s'. Error: %d\n", path, errno);
+    return -1;
+  }
+  return 0;
+}
+
+preflop_table_t *open_preflop_table(const char *path)
+/* Maps a table file written by write_preflop_table. Returns NULL on error. */
+{
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+  {
+    fprintf(stderr, "Failed to open file '%s'. Error: %d\n", path, errno);
+    return NULL;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || (size_t) st.st_size != TABLE_SIZE)
+  {
+    fprintf(stderr, "'%s' is not a preflop table of version %d.\n", path, PREFLOP_VERSION);
+    close(fd);
+    return NULL;
+  }
+  void *map = mmap(NULL, TABLE_SIZE, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED)
+  {
+    fprintf(stderr, "Failed to map file '%s'. Error: %d\n", path, errno);
+    return NULL;
+  }
+  const preflop_header_t *header = map;
+  if (memcmp(header->magic, PREFLOP_MAGIC, sizeof(header->magic)) != 0 ||
+      header->version != PREFLOP_VERSION || header->n_classes != PREFLOP_CLASSES ||
+      header->n_combos != PREFLOP_COMBOS)
+  {
+    fprintf(stderr, "'%s' is not a preflop table of version %d.\n", path, PREFLOP_VERSION);
+    munmap(map, TABLE_SIZE);
+    return NULL;
+  }
+  preflop_table_t *table = malloc(sizeof(*table));
+  if (table == NULL)
+  {
+    fprintf(stderr, "Failed to allocate memory for preflop table. Error: %d\n", errno);
+    munmap(map, TABLE_SIZE);
+    return NULL;
+  }
+  table->map = map;
+  table->map_size = TABLE_SIZE;
+  table->exact = header->exact;
+  table->n_trials = header->n_trials;
+  table->matchups = (const preflop_entry_t *) (header + 1);
+  table->vs_random = (const preflop_random_t *) (table->matchups + N_MATCHUPS);
+  return table;
+}
+
+static sim_result_t *two_hand_result(int exact, uint64_t n_trials, uint64_t wins, uint64_t ties,
+                                     int swap)
+{
+  sim_result_t *res = init_sim_result(2);
+  if (res == NULL) return NULL;
+  res->exact = exact;
+  res->n_trials = n_trials;
+  res->wins[swap] = wins;
+  res->wins[!swap] = n_trials - wins - ties;
+  res->ties[0] = ties;
+  res->ties[1] = ties;
+  res->split_ties[split_index(2, 0, 2)] = ties;
+  res->split_ties[split_index(2, 1, 2)] = ties;
+  return res;
+}
+
+sim_result_t *preflop_lookup(preflop_table_t *table, cardset_t hand, cardset_t other)
+/* Returns the result of hand against other with five unknown board cards,
+ * or NULL if they are not two disjoint two-card hands.
+ */
+{
+  if (!is_two_cards(hand) || !is_two_cards(other) || (hand & other) != 0) return NULL;
+  unsigned char to[NUM_SUITS];
+  unsigned cls = preflop_class(hand, to);
+  unsigned combo = preflop_combo_index(cardset_map_suits(other, to));
+  const preflop_entry_t *e = &table->matchups[cls * PREFLOP_COMBOS + combo];
+  return two_hand_result(table->exact, table->n_trials, e->wins, e->ties, 0);
+}
+
+sim_result_t *preflop_vs_random(preflop_table_t *table, cardset_t hand)
+/* Returns the result of hand (first) against a random hand, or NULL if hand
+ * is not a two-card hand.
+ */
+{
+  if (!is_two_cards(hand)) return NULL;
+  unsigned char to[NUM_SUITS];
+  const preflop_random_t *r = &table->vs_random[preflop_class(hand, to)];
+  return two_hand_result(table->exact, r->n_trials, r->wins, r->ties, 0);
+}
+
+sim_result_t *preflop_lookup_scenario(preflop_table_t *table, scenario_t *sc)
+/* Answers sc from the table if it is two hands of two cards each, or one
+ * hand of two cards against one of two unknown cards, sharing five unknown
+ * board cards. Returns NULL for any other scenario.
+ */
+{
+  if (sc->n_hands != 2) return NULL;
+  size_t n_shared = 0;
+  size_t n_own[2] = { 0, 0 };
+  for (size_t s = 0; s < sc->n_slots; ++s)
+  {
+    int u0 = scenario_uses(sc, 0, s);
+    int u1 = scenario_uses(sc, 1, s);
+    if (u0 && u1) ++n_shared;
+    else if (u0) ++n_own[0];
+    else if (u1) ++n_own[1];
+  }
+  if (n_shared != PREFLOP_BOARD) return NULL;
+  for (int h = 0; h < 2; ++h)
+  {
+    if (cardset_size(sc->known[h]) + n_own[h] != 2) return NULL;
+  }
+  if (n_own[0] == 0 && n_own[1] == 0)
+  {
+    return preflop_lookup(table, sc->known[0], sc->known[1]);
+  }
+  for (int h = 0; h < 2; ++h)
+  {
+    if (n_own[h] == 0 && n_own[!h] == 2)
+    {
+      sim_result_t *res = preflop_vs_random(table, sc->known[h]);
+      if (res == NULL || h == 0) return res;
+      sim_result_t *swapped = two_hand_result(res->exact, res->n_trials, res->wins[0],
+                                              res->ties[0], 1);
+      free_sim_result(res);
+      return swapped;
+    }
+  }
+  return NULL;
+}
+
+void close_preflop_table(preflop_table_t *table)
+{
+  if (table == NULL) return;
+  munmap(table->map, table->map_size);
+  free(table);
+}
@@ -0,0 +1,64 @@
+#ifndef PREFLOP_H
+#define PREFLOP_H
+#include <stdint.h>
+#include "cardset.h"
+#include "scenario.h"
+#include "sim.h"
+
+/* Precomputed equities of two-card starting hands with five unknown board
+ * cards: every starting hand against every other, and against a random
+ * hand.
+ *
+ * The 1326 starting hands fall into 169 classes (13 pairs, 78 suited and
+ * 78 offsuit hands) whose members differ only by suit. preflop_class maps a
+ * hand onto its class representative (high card a spade, low card a spade
+ * if suited and a heart otherwise) with a suit relabelling, and the same
+ * relabelling maps the opponent's hand, so the table needs one row of 1326
+ * opponents per class. Rows are filled for every opponent, so a lookup is
+ * two index computations and one load.
+ *
+ * The table file is a header, the 169 x 1326 matchups and the 169 results
+ * against a random hand, in the host's byte order. It is mapped read-only.
+ */
+#define PREFLOP_MAGIC "PKRPREFL"
+#define PREFLOP_VERSION 1
+#define PREFLOP_CLASSES 169
+#define PREFLOP_COMBOS 1326
+#define PREFLOP_BOARD 5
+
+/* The first hand's wins, and the trials in which the two hands tie. */
+struct preflop_entry_tag {
+  uint32_t wins;
+  uint32_t ties;
+};
+typedef struct preflop_entry_tag preflop_entry_t;
+
+struct preflop_random_tag {
+  uint64_t n_trials;
+  uint64_t wins;
+  uint64_t ties;
+};
+typedef struct preflop_random_tag preflop_random_t;
+
+struct preflop_table_tag {
+  void *map;
+  size_t map_size;
+  int exact;                          /* entries are exact enumerations */
+  uint64_t n_trials;                  /* outcomes or trials per matchup */
+  const preflop_entry_t *matchups;    /* [class * PREFLOP_COMBOS + combo] */
+  const preflop_random_t *vs_random;  /* [class] */
+};
+typedef struct preflop_table_tag preflop_table_t;
+
+unsigned preflop_combo_index(cardset_t hand);
+unsigned preflop_class(cardset_t hand, unsigned char to[NUM_SUITS]);
+cardset_t preflop_class_hand(unsigned cls);
+void preflop_class_name(unsigned cls, char name[4]);
+int write_preflop_table(const char *path, int exact, uint64_t n_trials,
+                        const preflop_entry_t *matchups, const preflop_random_t *vs_random);
+preflop_table_t *open_preflop_table(const char *path);
+sim_result_t *preflop_lookup(preflop_table_t *table, cardset_t hand, cardset_t other);
+sim_result_t *preflop_vs_random(preflop_table_t *table, cardset_t hand);
+sim_result_t *preflop_lookup_scenario(preflop_table_t *table, scenario_t *sc);
+void close_preflop_table(preflop_table_t *table);
+#endif
@@ -0,0 +1,351 @@
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "range.h"
+
+#define ITEM_LIMIT 32
+
+static int rank_of(char c)
+/* Returns the rank index (0 for a deuce, 12 for an ace) of a value letter,
+ * or -1.
+ */
+{
+  static const char ranks[] = "23456789TJQKA";
+  if (c == '0') return 8;
+  const char *p = c != '\0' ? strchr(ranks, c) : NULL;
+  return p != NULL ? (int) (p - ranks) : -1;
+}
+
+static int suit_of(char c)
+{
+  switch (c)
+  {
+    case 's': return SPADES;
+    case 'h': return HEARTS;
+    case 'd': return DIAMONDS;
+    case 'c': return CLUBS;
+  }
+  return -1;
+}
+
+static cardset_t card_at(int rank, int suit)
+{
+  return cardset_from_num(suit * 13 + rank);
+}
+
+static void add_combo(range_t *range, short *index_of, cardset_t combo, unsigned weight)
+{
+  unsigned lo = __builtin_ctzll(combo);
+  unsigned hi = 63 - __builtin_clzll(combo);
+  unsigned key = hi * (hi - 1) / 2 + lo;
+  if (index_of[key] < 0)
+  {
+    index_of[key] = range->n_combos++;
+  }
+  range->combos[index_of[key]] = combo;
+  range->weights[index_of[key]] = weight;
+}
+
+static void add_ranks(range_t *range, short *index_of, int hi, int lo, char kind, unsigned weight)
+/* Adds every combination of ranks hi and lo; kind is 's' for suited only,
+ * 'o' for offsuit only, or '\0' for both (pairs are always offsuit).
+ */
+{
+  for (int s1 = 0; s1 < NUM_SUITS; ++s1)
+  {
+    for (int s2 = 0; s2 < NUM_SUITS; ++s2)
+    {
+      if (hi == lo && s2 <= s1) continue;
+      if (kind == 's' && s1 != s2) continue;
+      if (kind == 'o' && s1 == s2) continue;
+      add_combo(range, index_of, card_at(hi, s1) | card_at(lo, s2), weight);
+    }
+  }
+}
+
+static int parse_item(range_t *range, short *index_of, const char *item, unsigned weight)
+/* Adds the combinations of one item without its weight. Returns 0 on
+ * success.
+ */
+{
+  size_t n = strlen(item);
+  if (n == 4 && rank_of(item[0]) >= 0 && suit_of(item[1]) >= 0 &&
+      rank_of(item[2]) >= 0 && suit_of(item[3]) >= 0)
+  {
+    cardset_t a = card_at(rank_of(item[0]), suit_of(item[1]));
+    cardset_t b = card_at(rank_of(item[2]), suit_of(item[3]));
+    if (a == b) return -1;
+    add_combo(range, index_of, a | b, weight);
+    return 0;
+  }
+  int r1 = rank_of(item[0]);
+  int r2 = n > 1 ? rank_of(item[1]) : -1;
+  if (r1 < 0 || r2 < 0) return -1;
+  int hi = r1 > r2 ? r1 : r2;
+  int lo = r1 > r2 ? r2 : r1;
+  size_t p = 2;
+  char kind = '\0';
+  if (item[p] == 's' || item[p] == 'o')
+  {
+    if (hi == lo) return -1;
+    kind = item[p++];
+  }
+  int first = lo;
+  int last = lo;
+  if (item[p] == '+')
+  {
+    last = hi == lo ? 12 : hi - 1;
+    ++p;
+  }
+  else if (item[p] == '-')
+  {
+    int r3 = rank_of(item[p + 1]);
+    int r4 = r3 >= 0 ? rank_of(item[p + 2]) : -1;
+    if (r3 < 0 || r4 < 0) return -1;
+    int hi2 = r3 > r4 ? r3 : r4;
+    int lo2 = r3 > r4 ? r4 : r3;
+    p += 3;
+    char kind2 = '\0';
+    if (item[p] == 's' || item[p] == 'o') kind2 = item[p++];
+    if ((hi == lo) != (hi2 == lo2) || kind2 != kind || (hi != lo && hi2 != hi)) return -1;
+    first = lo < lo2 ? lo : lo2;
+    last = lo < lo2 ? lo2 : lo;
+  }
+  if (item[p] != '\0') return -1;
+  for (int r = first; r <= last; ++r)
+  {
+    if (hi == lo) add_ranks(range, index_of, r, r, kind, weight);
+    else add_ranks(range, index_of, hi, r, kind, weight);
+  }
+  return 0;
+}
+
+range_t *init_range(arena_t *arena)
+/* Returns an empty range allocated from arena (or with malloc if arena is
+ * NULL), or NULL on error.
+ */
+{
+  range_t *range = arena != NULL ? arena_alloc(arena, sizeof(*range)) : malloc(sizeof(*range));
+  if (range == NULL)
+  {
+    fprintf(stderr, "Failed to allocate memory for range. Error: %d\n", errno);
+    return NULL;
+  }
+  range->n_combos = 0;
+  range->arena = arena;
+  return range;
+}
+
+range_t *parse_range(const char *text, size_t length, arena_t *arena)
+/* Parses the first length characters of text as a range, allocated from
+ * arena (or with malloc if arena is NULL). Returns NULL if the text is
+ * malformed or names no combination.
+ */
+{
+  range_t *range = init_range(arena);
+  if (range == NULL) return NULL;
+  short index_of[RANGE_MAX_COMBOS];
+  memset(index_of, -1, sizeof(index_of));
+  size_t start = 0;
+  while (start <= length)
+  {
+    size_t end = start;
+    while (end < length && text[end] != ',')
+    {
+      ++end;
+    }
+    char item[ITEM_LIMIT];
+    size_t n = 0;
+    int too_long = 0;
+    for (size_t i = start; i < end; ++i)
+    {
+      if (text[i] == ' ' || text[i] == '\t') continue;
+      if (n + 1 == ITEM_LIMIT) too_long = 1;
+      else item[n++] = text[i];
+    }
+    item[n] = '\0';
+    unsigned weight = RANGE_WEIGHT_UNIT;
+    char *colon = strchr(item, ':');
+    if (colon != NULL)
+    {
+      char *rest;
+      double w = strtod(colon + 1, &rest);
+      if (*rest != '\0' || !(w > 0 && w <= 1)) too_long = 1;
+      long units = lround(w * RANGE_WEIGHT_UNIT);
+      weight = units > 0 ? units : 1;
+      *colon = '\0';
+    }
+    if (too_long || parse_item(range, index_of, item, weight) != 0)
+    {
+      fprintf(stderr, "Invalid range item '%.*s'.\n", (int) (end - start), text + start);
+      free_range(range);
+      return NULL;
+    }
+    start = end + 1;
+  }
+  if (range->n_combos == 0)
+  {
+    fprintf(stderr, "Empty range.\n");
+    free_range(range);
+    return NULL;
+  }
+  return range;
+}
+
+range_t *copy_range_in(const range_t *range, arena_t *arena)
+{
+  range_t *copy = init_range(arena);
+  if (copy == NULL) return NULL;
+  copy->n_combos = range->n_combos;
+  memcpy(copy->combos, range->combos, sizeof(*copy->combos) * range->n_combos);
+  memcpy(copy->weights, range->weights, sizeof(*copy->weights) * range->n_combos);
+  return copy;
+}
+
+static int of_kind(int hi, int lo, int s1, int s2, char kind)
+/* Whether the cards of ranks hi and lo and suits s1 and s2 are a
+ * combination of the given kind (see add_ranks), counted once.
+ */
+{
+  if (hi == lo) return s1 < s2;
+  return kind == '\0' || (kind == 's') == (s1 == s2);
+}
+
+static int held_as_item(unsigned weight_of[DECK_SIZE][DECK_SIZE], int hi, int lo, char kind,
+                        unsigned *weight)
+/* Whether weight_of holds every combination of ranks hi and lo of the
+ * given kind, all with one weight, which is left in *weight.
+ */
+{
+  *weight = 0;
+  for (int s1 = 0; s1 < NUM_SUITS; ++s1)
+  {
+    for (int s2 = 0; s2 < NUM_SUITS; ++s2)
+    {
+      if (!of_kind(hi, lo, s1, s2, kind)) continue;
+      unsigned w = weight_of[s1 * 13 + hi][s2 * 13 + lo];
+      if (w == 0 || (*weight != 0 && w != *weight)) return 0;
+      *weight = w;
+    }
+  }
+  return 1;
+}
+
+static void print_item_weight(FILE *f, unsigned weight)
+{
+  if (weight != RANGE_WEIGHT_UNIT) fprintf(f, ":%g", (double) weight / RANGE_WEIGHT_UNIT);
+}
+
+static int print_kind(FILE *f, unsigned weight_of[DECK_SIZE][DECK_SIZE], int hi, int lo,
+                      char kind, int first)
+/* Prints the combinations of ranks hi and lo of the given kind that
+ * weight_of holds: as one item if it holds them all with one weight, and
+ * one by one otherwise. Returns 0 once anything has been printed, and first
+ * if nothing was.
+ */
+{
+  static const char letters[] = "234567890JQKA";
+  static const char suits[] = "shdc";
+  unsigned weight;
+  if (held_as_item(weight_of, hi, lo, kind, &weight))
+  {
+    fprintf(f, "%s%c%c", first ? "" : ", ", letters[hi], letters[lo]);
+    if (hi != lo && kind != '\0') fputc(kind, f);
+    print_item_weight(f, weight);
+    return 0;
+  }
+  for (int s1 = 0; s1 < NUM_SUITS; ++s1)
+  {
+    for (int s2 = 0; s2 < NUM_SUITS; ++s2)
+    {
+      unsigned w = weight_of[s1 * 13 + hi][s2 * 13 + lo];
+      if (!of_kind(hi, lo, s1, s2, kind) || w == 0) continue;
+      fprintf(f, "%s%c%c%c%c", first ? "" : ", ", letters[hi], suits[s1], letters[lo], suits[s2]);
+      print_item_weight(f, w);
+      first = 0;
+    }
+  }
+  return first;
+}
+
+void fprint_range(FILE *f, const range_t *range)
+/* Prints range in square brackets, in the syntax parse_range reads: a pair,
+ * or the suited, offsuit or all combinations of two ranks, as one item when
+ * the range holds them all with one weight, and its other combinations one
+ * by one, from aces down.
+ */
+{
+  unsigned weight_of[DECK_SIZE][DECK_SIZE];
+  memset(weight_of, 0, sizeof(weight_of));
+  for (size_t i = 0; i < range->n_combos; ++i)
+  {
+    unsigned c1 = __builtin_ctzll(range->combos[i]);
+    unsigned c2 = 63 - __builtin_clzll(range->combos[i]);
+    weight_of[c1][c2] = weight_of[c2][c1] = range->weights[i];
+  }
+  int first = 1;
+  fputc('[', f);
+  for (int hi = 12; hi >= 0; --hi)
+  {
+    first = print_kind(f, weight_of, hi, hi, '\0', first);
+    for (int lo = hi - 1; lo >= 0; --lo)
+    {
+      unsigned weight;
+      if (held_as_item(weight_of, hi, lo, '\0', &weight))
+      {
+        first = print_kind(f, weight_of, hi, lo, '\0', first);
+        continue;
+      }
+      first = print_kind(f, weight_of, hi, lo, 's', first);
+      first = print_kind(f, weight_of, hi, lo, 'o', first);
+    }
+  }
+  fputc(']', f);
+}
+
+static int can_deal_from(const range_t *const *ranges, size_t n_ranges, cardset_t taken)
+{
+  if (n_ranges == 0) return 1;
+  for (size_t i = 0; i < ranges[0]->n_combos; ++i)
+  {
+    cardset_t combo = ranges[0]->combos[i];
+    if ((combo & taken) == 0 && can_deal_from(ranges + 1, n_ranges - 1, taken | combo))
+    {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+int ranges_can_deal(range_t *const *ranges, size_t n_ranges, cardset_t dead)
+/* Returns 1 if every one of the n_ranges ranges (NULL ones are skipped) can
+ * be dealt a combination holding no card of dead, no two sharing a card,
+ * and 0 otherwise. The ranges with the fewest combinations are tried
+ * first, so that a search bound to fail usually fails early.
+ */
+{
+  const range_t *order[DECK_SIZE / 2];
+  size_t n = 0;
+  for (size_t i = 0; i < n_ranges; ++i)
+  {
+    if (ranges[i] == NULL) continue;
+    if (n == DECK_SIZE / 2) return 0;
+    size_t j = n++;
+    while (j > 0 && order[j - 1]->n_combos > ranges[i]->n_combos)
+    {
+      order[j] = order[j - 1];
+      --j;
+    }
+    order[j] = ranges[i];
+  }
+  return can_deal_from(order, n, dead);
+}
+
+void free_range(range_t *range)
+/* Frees a malloced range; a range in an arena is released with the arena. */
+{
+  if (range == NULL || range->arena != NULL) return;
+  free(range);
+}
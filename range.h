@@ -0,0 +1,34 @@
+#ifndef RANGE_H
+#define RANGE_H
+#include <stdio.h>
+#include "arena.h"
+#include "cardset.h"
+
+/* A weighted set of two-card starting hands, written in the usual range
+ * syntax: comma-separated items such as QQ+ (pairs from queens up), 22-55,
+ * AKs (suited), AQo (offsuit), AJ (both), A2s+ or A2s-A5s (kickers from the
+ * deuce up, or from the deuce to the five), and AhKh (one combination).
+ * Tens are written 0 as elsewhere in the input, or T. An item may end with
+ * :w, 0 < w <= 1, to hold its combinations with that relative weight.
+ *
+ * Weights are kept in units of 1/RANGE_WEIGHT_UNIT so that weighted counts
+ * stay integers. A combination listed twice keeps its last weight.
+ */
+#define RANGE_MAX_COMBOS 1326
+#define RANGE_WEIGHT_UNIT 100
+
+struct range_tag {
+  size_t n_combos;
+  cardset_t combos[RANGE_MAX_COMBOS];
+  unsigned weights[RANGE_MAX_COMBOS];
+  arena_t *arena;  /* owner of the range, or NULL if it was malloced */
+};
+typedef struct range_tag range_t;
+
+range_t *init_range(arena_t *arena);
+range_t *parse_range(const char *text, size_t length, arena_t *arena);
+range_t *copy_range_in(const range_t *range, arena_t *arena);
+void fprint_range(FILE *f, const range_t *range);
+int ranges_can_deal(range_t *const *ranges, size_t n_ranges, cardset_t dead);
+void free_range(range_t *range);
+#endif
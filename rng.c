@@ -0,0 +1,60 @@
+#include "rng.h"
+
+static uint64_t splitmix64(uint64_t *x)
+{
+  uint64_t z = (*x += 0x9e3779b97f4a7c15ULL);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+void rng_seed(rng_t *rng, uint64_t seed)
+/* Expands a 64-bit seed into a full generator state with splitmix64, as the
+ * xoshiro authors recommend, so that nearby seeds give unrelated streams.
+ */
+{
+  for (int i = 0; i < 4; ++i)
+  {
+    rng->s[i] = splitmix64(&seed);
+  }
+}
+
+void rng_jump(rng_t *rng)
+/* Advances the generator by 2^128 steps. Seeding once and jumping i times
+ * for stream i gives streams that can never overlap in practice.
+ */
+{
+  static const uint64_t jump[] = { 0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL,
+                                   0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL };
+  uint64_t s[4] = { 0, 0, 0, 0 };
+  for (int i = 0; i < 4; ++i)
+  {
+    for (int b = 0; b < 64; ++b)
+    {
+      if (jump[i] & (((uint64_t) 1) << b))
+      {
+        for (int j = 0; j < 4; ++j)
+        {
+          s[j] ^= rng->s[j];
+        }
+      }
+      rng_next(rng);
+    }
+  }
+  for (int j = 0; j < 4; ++j)
+  {
+    rng->s[j] = s[j];
+  }
+}
+
+void philox_start(philox_t *p, uint64_t seed, uint64_t stream)
+/* Starts stream number stream of seed at its first output. */
+{
+  p->key[0] = (uint32_t) seed;
+  p->key[1] = (uint32_t) (seed >> 32);
+  p->ctr[0] = 0;
+  p->ctr[1] = 0;
+  p->ctr[2] = (uint32_t) stream;
+  p->ctr[3] = (uint32_t) (stream >> 32);
+  p->next = PHILOX_WORDS;
+}
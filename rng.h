@@ -0,0 +1,123 @@
+#ifndef RNG_H
+#define RNG_H
+#include <stdint.h>
+
+/* xoshiro256** pseudo-random number generator. All of its state lives in an
+ * rng_t owned by the caller, so every thread can carry its own generator
+ * without locking, and a generator can be copied, saved or restored.
+ */
+struct rng_tag {
+  uint64_t s[4];
+};
+typedef struct rng_tag rng_t;
+
+void rng_seed(rng_t *rng, uint64_t seed);
+void rng_jump(rng_t *rng);
+
+static inline uint64_t rng_rotl(uint64_t x, int k)
+{
+  return (x << k) | (x >> (64 - k));
+}
+
+static inline uint64_t rng_next(rng_t *rng)
+{
+  uint64_t *s = rng->s;
+  uint64_t result = rng_rotl(s[1] * 5, 7) * 9;
+  uint64_t t = s[1] << 17;
+  s[2] ^= s[0];
+  s[3] ^= s[1];
+  s[1] ^= s[2];
+  s[0] ^= s[3];
+  s[2] ^= t;
+  s[3] = rng_rotl(s[3], 45);
+  return result;
+}
+
+static inline uint32_t rng_bounded(rng_t *rng, uint32_t n)
+/* A uniformly distributed integer in [0, n), n > 0, by Lemire's
+ * multiply-and-reject method (no division in the common case).
+ */
+{
+  uint64_t m = (rng_next(rng) >> 32) * n;
+  uint32_t low = (uint32_t) m;
+  if (low < n)
+  {
+    uint32_t threshold = -n % n;
+    while (low < threshold)
+    {
+      m = (rng_next(rng) >> 32) * n;
+      low = (uint32_t) m;
+    }
+  }
+  return m >> 32;
+}
+
+/* Philox4x32-10 (Salmon et al., "Parallel random numbers: as easy as 1, 2,
+ * 3"), a counter-based generator: output block c of stream s under a seed
+ * is a fixed function of (seed, s, c), ten rounds of multiplications and
+ * key additions over the 128-bit counter (c, s). Any stream can be started
+ * directly, without generating the ones before it, so the simulation gives
+ * trial i its own stream i and a trial's cards depend only on the seed and
+ * i, whichever thread, shard or round runs it.
+ */
+#define PHILOX_WORDS 4
+
+struct philox_tag {
+  uint32_t key[2];
+  uint32_t ctr[4];             /* block number (ctr[0], ctr[1]), stream (ctr[2], ctr[3]) */
+  uint32_t out[PHILOX_WORDS];  /* the current block */
+  unsigned next;               /* next unused word of out */
+};
+typedef struct philox_tag philox_t;
+
+void philox_start(philox_t *p, uint64_t seed, uint64_t stream);
+
+static inline void philox_block(philox_t *p)
+/* Computes the block of the current counter into out and steps the
+ * counter.
+ */
+{
+  uint32_t c0 = p->ctr[0], c1 = p->ctr[1], c2 = p->ctr[2], c3 = p->ctr[3];
+  uint32_t k0 = p->key[0], k1 = p->key[1];
+  for (int r = 0; r < 10; ++r)
+  {
+    uint64_t m0 = (uint64_t) 0xD2511F53u * c0;
+    uint64_t m1 = (uint64_t) 0xCD9E8D57u * c2;
+    c0 = (uint32_t) (m1 >> 32) ^ c1 ^ k0;
+    c1 = (uint32_t) m1;
+    c2 = (uint32_t) (m0 >> 32) ^ c3 ^ k1;
+    c3 = (uint32_t) m0;
+    k0 += 0x9E3779B9u;
+    k1 += 0xBB67AE85u;
+  }
+  p->out[0] = c0;
+  p->out[1] = c1;
+  p->out[2] = c2;
+  p->out[3] = c3;
+  p->next = 0;
+  if (++p->ctr[0] == 0) ++p->ctr[1];
+}
+
+static inline uint32_t philox_next(philox_t *p)
+{
+  if (p->next == PHILOX_WORDS) philox_block(p);
+  return p->out[p->next++];
+}
+
+static inline uint32_t philox_bounded(philox_t *p, uint32_t n)
+/* A uniformly distributed integer in [0, n), n > 0, as rng_bounded. */
+{
+  uint64_t m = (uint64_t) philox_next(p) * n;
+  uint32_t low = (uint32_t) m;
+  if (low < n)
+  {
+    uint32_t threshold = -n % n;
+    while (low < threshold)
+    {
+      m = (uint64_t) philox_next(p) * n;
+      low = (uint32_t) m;
+    }
+  }
+  return m >> 32;
+}
+#endif
@@ -0,0 +1,146 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "scenario.h"
+
+scenario_t *init_scenario(size_t n_hands, size_t n_slots)
+/* Returns a scenario of n_hands hands with no known cards, in which no hand
+ * holds any of the n_slots unknown cards yet, or NULL on error.
+ */
+{
+  scenario_t *sc = malloc(sizeof(*sc));
+  if (sc == NULL)
+  {
+    fprintf(stderr, "Failed to allocate memory for scenario. Error: %d\n", errno);
+    return NULL;
+  }
+  sc->n_hands = n_hands;
+  sc->n_slots = n_slots;
+  sc->dead = CARDSET_EMPTY;
+  sc->ranges = NULL;
+  sc->known = calloc(n_hands > 0 ? n_hands : 1, sizeof(*sc->known));
+  sc->uses = calloc(n_hands * n_slots + 1, sizeof(*sc->uses));
+  if (sc->known == NULL || sc->uses == NULL)
+  {
+    fprintf(stderr, "Failed to allocate memory for scenario. Error: %d\n", errno);
+    free_scenario(sc);
+    return NULL;
+  }
+  return sc;
+}
+
+scenario_t *compile_scenario(deck_t **hands, size_t n_hands, future_cards_t *fc)
+/* Builds the scenario for hands and the placeholders in fc, which must point
+ * into those hands (as set up by read_input). Returns NULL on error.
+ */
+{
+  scenario_t *sc = init_scenario(n_hands, fc->n_decks);
+  if (sc == NULL) return NULL;
+  for (size_t h = 0; h < n_hands; ++h)
+  {
+    sc->known[h] = cardset_from_deck(hands[h]);
+    sc->dead |= sc->known[h];
+  }
+  if (fc->n_ranges > 0)
+  {
+    sc->ranges = calloc(n_hands, sizeof(*sc->ranges));
+    if (sc->ranges == NULL)
+    {
+      fprintf(stderr, "Failed to allocate memory for scenario. Error: %d\n", errno);
+      free_scenario(sc);
+      return NULL;
+    }
+    for (size_t h = 0; h < n_hands; ++h)
+    {
+      sc->ranges[h] = range_of_hand(fc, hands[h]);
+    }
+  }
+  for (size_t s = 0; s < fc->n_decks; ++s)
+  {
+    for (size_t j = 0; j < fc->decks[s].n_cards; ++j)
+    {
+      card_t *ptr = fc->decks[s].cards[j];
+      int found = 0;
+      for (size_t h = 0; h < n_hands && !found; ++h)
+      {
+        for (size_t k = 0; k < hands[h]->n_cards; ++k)
+        {
+          if (hands[h]->cards[k] == ptr)
+          {
+            sc->uses[h * sc->n_slots + s] = 1;
+            found = 1;
+            break;
+          }
+        }
+      }
+      if (!found)
+      {
+        fprintf(stderr, "Unknown card ?%zu does not belong to any hand.\n", s);
+        free_scenario(sc);
+        return NULL;
+      }
+    }
+  }
+  return sc;
+}
+
+int scenario_uses(scenario_t *sc, size_t hand, size_t slot)
+{
+  return sc->uses[hand * sc->n_slots + slot];
+}
+
+int slot_is_used(scenario_t *sc, size_t slot)
+{
+  for (size_t h = 0; h < sc->n_hands; ++h)
+  {
+    if (scenario_uses(sc, h, slot)) return 1;
+  }
+  return 0;
+}
+
+static uint64_t hash_bytes(uint64_t h, const void *data, size_t len)
+/* Continues an FNV-1a hash over len bytes. */
+{
+  const unsigned char *p = data;
+  for (size_t i = 0; i < len; ++i)
+  {
+    h = (h ^ p[i]) * 0x100000001b3ULL;
+  }
+  return h;
+}
+
+uint64_t scenario_hash(scenario_t *sc)
+/* A hash of everything that describes sc, in its own hand and ?n order, so
+ * that runs of the same input can check that they belong together.
+ */
+{
+  uint64_t h = 0xcbf29ce484222325ULL;
+  uint64_t sizes[2] = { sc->n_hands, sc->n_slots };
+  h = hash_bytes(h, sizes, sizeof(sizes));
+  h = hash_bytes(h, sc->known, sizeof(*sc->known) * sc->n_hands);
+  h = hash_bytes(h, sc->uses, sc->n_hands * sc->n_slots);
+  for (size_t i = 0; sc->ranges != NULL && i < sc->n_hands; ++i)
+  {
+    const range_t *range = sc->ranges[i];
+    uint64_t n = range != NULL ? range->n_combos : 0;
+    h = hash_bytes(h, &n, sizeof(n));
+    if (range == NULL) continue;
+    h = hash_bytes(h, range->combos, sizeof(*range->combos) * n);
+    h = hash_bytes(h, range->weights, sizeof(*range->weights) * n);
+  }
+  return h;
+}
+
+int scenario_has_ranges(scenario_t *sc)
+{
+  return sc->ranges != NULL;
+}
+
+void free_scenario(scenario_t *sc)
+{
+  if (sc == NULL) return;
+  free(sc->ranges);
+  free(sc->known);
+  free(sc->uses);
+  free(sc);
+}
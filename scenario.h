@@ -0,0 +1,32 @@
+#ifndef SCENARIO_H
+#define SCENARIO_H
+#include <stdint.h>
+#include "cardset.h"
+#include "deck.h"
+#include "future.h"
+
+/* A read-only description of a parsed input: the known cards of every hand
+ * as a card set, which unknown cards (?n) each hand holds, and the ranges of
+ * hands whose hole cards come from a range. Many threads can share one
+ * scenario without copying it. The ranges belong to the future_cards_t the
+ * scenario was compiled from.
+ */
+struct scenario_tag {
+  size_t n_hands;
+  size_t n_slots;       /* one per ?n index, including indices no hand uses */
+  cardset_t *known;     /* known[h] is the set of known cards of hand h */
+  cardset_t dead;       /* every known card of every hand */
+  unsigned char *uses;  /* uses[h * n_slots + s] is 1 if hand h holds ?s */
+  range_t **ranges;     /* ranges[h] is hand h's range, or NULL; the array
+                           itself is NULL if no hand has a range */
+};
+typedef struct scenario_tag scenario_t;
+
+scenario_t *init_scenario(size_t n_hands, size_t n_slots);
+scenario_t *compile_scenario(deck_t **hands, size_t n_hands, future_cards_t *fc);
+int scenario_uses(scenario_t *sc, size_t hand, size_t slot);
+int slot_is_used(scenario_t *sc, size_t slot);
+uint64_t scenario_hash(scenario_t *sc);
+int scenario_has_ranges(scenario_t *sc);
+void free_scenario(scenario_t *sc);
+#endif
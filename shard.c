@@ -0,0 +1,237 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "shard.h"
+
+struct shard_header_tag {
+  char magic[8];
+  uint32_t version;
+  uint32_t n_hands;
+  uint64_t scenario_hash;
+  uint64_t seed;
+  uint64_t run_trials;
+  uint32_t sampling;
+  uint32_t n_shards;
+  uint32_t n_covered;
+  uint32_t reserved;
+  uint64_t n_trials;
+  uint64_t batch_size;  /* 0 if the batches are not stored */
+  uint64_t n_batches;
+};
+typedef struct shard_header_tag shard_header_t;
+
+static size_t shard_list_size(size_t n_covered)
+/* Bytes taken by the shard ids, padded to a multiple of 8. */
+{
+  return (sizeof(uint32_t) * n_covered + 7) & ~(size_t) 7;
+}
+
+int write_partial_result(const char *path, const partial_result_t *part)
+/* Writes a partial result file. Returns 0 on success and -1 on error. */
+{
+  FILE *f = fopen(path, "wb");
+  if (f == NULL)
+  {
+    fprintf(stderr, "Failed to open file '%s'. Error: %d\n", path, errno);
+    return -1;
+  }
+  const sim_result_t *res = part->res;
+  shard_header_t header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, SHARD_MAGIC, sizeof(header.magic));
+  header.version = SHARD_VERSION;
+  header.n_hands = res->n_hands;
+  header.scenario_hash = part->scenario_hash;
+  header.seed = part->seed;
+  header.run_trials = part->run_trials;
+  header.sampling = part->sampling;
+  header.n_shards = part->n_shards;
+  header.n_covered = part->n_covered;
+  header.n_trials = res->n_trials;
+  header.batch_size = res->batch_size;
+  header.n_batches = res->n_batches;
+  size_t list_size = shard_list_size(part->n_covered);
+  uint32_t *list = calloc(list_size / sizeof(*list) + 1, sizeof(*list));
+  int ok = list != NULL;
+  if (ok)
+  {
+    memcpy(list, part->shards, sizeof(*list) * part->n_covered);
+    ok = fwrite(&header, sizeof(header), 1, f) == 1 &&
+         fwrite(list, 1, list_size, f) == list_size;
+  }
+  size_t n = res->n_hands;
+  for (size_t i = 0; ok && i < n; ++i)
+  {
+    uint64_t wins = res->wins[i];
+    ok = fwrite(&wins, sizeof(wins), 1, f) == 1 &&
+         fwrite(res->split_ties + i * (n - 1), sizeof(*res->split_ties), n - 1, f) == n - 1;
+  }
+  if (ok && res->batch_size > 0)
+  {
+    ok = fwrite(res->batch_sums, sizeof(*res->batch_sums), 2 * n, f) == 2 * n &&
+         fwrite(res->batch_squares, sizeof(*res->batch_squares), 2 * n, f) == 2 * n;
+  }
+  free(list);
+  if (fclose(f) != 0) ok = 0;
+  if (!ok)
+  {
+    fprintf(stderr, "Failed to write file '%s'. Error: %d\n", path, errno);
+    return -1;
+  }
+  return 0;
+}
+
+static int read_counts(FILE *f, const shard_header_t *header, partial_result_t *part)
+/* Reads the shard ids, counts and batches that follow header. Returns 0 on
+ * success.
+ */
+{
+  size_t list_size = shard_list_size(header->n_covered);
+  part->shards = malloc(list_size + sizeof(*part->shards));
+  part->res = init_sim_result(header->n_hands);
+  if (part->shards == NULL || part->res == NULL ||
+      fread(part->shards, 1, list_size, f) != list_size)
+  {
+    return -1;
+  }
+  for (size_t i = 0; i < header->n_covered; ++i)
+  {
+    if (part->shards[i] >= header->n_shards || (i > 0 && part->shards[i] <= part->shards[i - 1]))
+    {
+      return -1;
+    }
+  }
+  part->res->n_trials = header->n_trials;
+  size_t n = header->n_hands;
+  sim_result_t *res = part->res;
+  for (size_t i = 0; i < n; ++i)
+  {
+    uint64_t wins;
+    if (fread(&wins, sizeof(wins), 1, f) != 1 ||
+        fread(res->split_ties + i * (n - 1), sizeof(*res->split_ties), n - 1, f) != n - 1)
+    {
+      return -1;
+    }
+    res->wins[i] = wins;
+    for (size_t k = 2; k <= n; ++k)
+    {
+      res->ties[i] += res->split_ties[split_index(n, i, k)];
+    }
+  }
+  if (header->batch_size == 0)
+  {
+    return 0;
+  }
+  if (track_batches(res, header->batch_size) != 0 ||
+      fread(res->batch_sums, sizeof(*res->batch_sums), 2 * n, f) != 2 * n ||
+      fread(res->batch_squares, sizeof(*res->batch_squares), 2 * n, f) != 2 * n)
+  {
+    return -1;
+  }
+  res->n_batches = header->n_batches;
+  return 0;
+}
+
+partial_result_t *read_partial_result(const char *path)
+/* Reads a file written by write_partial_result. Returns NULL on error. */
+{
+  FILE *f = fopen(path, "rb");
+  if (f == NULL)
+  {
+    fprintf(stderr, "Failed to open file '%s'. Error: %d\n", path, errno);
+    return NULL;
+  }
+  shard_header_t header;
+  partial_result_t *part = NULL;
+  if (fread(&header, sizeof(header), 1, f) == 1 &&
+      memcmp(header.magic, SHARD_MAGIC, sizeof(header.magic)) == 0 &&
+      header.version == SHARD_VERSION && header.n_hands > 0 &&
+      header.n_covered > 0 && header.n_covered <= header.n_shards)
+  {
+    part = calloc(1, sizeof(*part));
+  }
+  if (part != NULL)
+  {
+    part->scenario_hash = header.scenario_hash;
+    part->seed = header.seed;
+    part->run_trials = header.run_trials;
+    part->sampling = header.sampling;
+    part->n_shards = header.n_shards;
+    part->n_covered = header.n_covered;
+    if (read_counts(f, &header, part) != 0)
+    {
+      free_partial_result(part);
+      part = NULL;
+    }
+  }
+  fclose(f);
+  if (part == NULL)
+  {
+    fprintf(stderr, "'%s' is not a partial result of version %d.\n", path, SHARD_VERSION);
+  }
+  return part;
+}
+
+int merge_partial_result(partial_result_t *total, const partial_result_t *part)
+/* Adds part to total. Returns -1, leaving total as it was, if they are not
+ * shards of the same run (scenario, seed, trial count, sampling and shard
+ * count, and so batch size) or share a shard.
+ */
+{
+  if (total->scenario_hash != part->scenario_hash || total->seed != part->seed ||
+      total->n_shards != part->n_shards || total->res->n_hands != part->res->n_hands)
+  {
+    fprintf(stderr, "The partial results are not of the same scenario, seed and shard count.\n");
+    return -1;
+  }
+  if (total->run_trials != part->run_trials || total->sampling != part->sampling ||
+      total->res->batch_size != part->res->batch_size)
+  {
+    fprintf(stderr, "The partial results are of different runs: %llu trials sampled with "
+            "methods %u, and %llu trials sampled with methods %u.\n",
+            (unsigned long long) total->run_trials, total->sampling,
+            (unsigned long long) part->run_trials, part->sampling);
+    return -1;
+  }
+  size_t n = total->n_covered + part->n_covered;
+  uint32_t *merged = malloc(sizeof(*merged) * n);
+  if (merged == NULL)
+  {
+    fprintf(stderr, "Failed to allocate memory for partial result. Error: %d\n", errno);
+    return -1;
+  }
+  size_t i = 0;
+  size_t j = 0;
+  size_t k = 0;
+  while (i < total->n_covered || j < part->n_covered)
+  {
+    if (i < total->n_covered && j < part->n_covered && total->shards[i] == part->shards[j])
+    {
+      fprintf(stderr, "Shard %u is in more than one partial result.\n", total->shards[i]);
+      free(merged);
+      return -1;
+    }
+    if (j == part->n_covered || (i < total->n_covered && total->shards[i] < part->shards[j]))
+    {
+      merged[k++] = total->shards[i++];
+    }
+    else
+    {
+      merged[k++] = part->shards[j++];
+    }
+  }
+  free(total->shards);
+  total->shards = merged;
+  total->n_covered = n;
+  add_sim_result(total->res, part->res);
+  return 0;
+}
+
+void free_partial_result(partial_result_t *part)
+{
+  if (part == NULL) return;
+  free(part->shards);
+  free_sim_result(part->res);
+  free(part);
+}
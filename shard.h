@@ -0,0 +1,41 @@
+#ifndef SHARD_H
+#define SHARD_H
+#include <stdint.h>
+#include "sim.h"
+
+/* Partial results of a simulation split into shards (see simulate_shard),
+ * one file per shard or per merge of shards, so that the shards can run as
+ * separate processes on separate machines and be combined later.
+ *
+ * A partial result file is a header, the sorted ids of the shards it
+ * covers (padded to a multiple of 8 bytes), for every hand its wins and
+ * its ties split 2 to n_hands ways, and, if the run counted batches (see
+ * sim_result_t), the batch sums and squares of every hand's wins and ties,
+ * all in the host's byte order. Two
+ * partial results merge if they are of the same scenario (by
+ * scenario_hash), seed and shard count, and cover different shards; the
+ * merge is itself a partial result. The header also records the trial
+ * count and sampling strategies of the whole run, since shards of runs
+ * that differ in either cover different trials and must not be merged.
+ * The merged batches give the variance reduction of the whole run.
+ */
+#define SHARD_MAGIC "PKRSHARD"
+#define SHARD_VERSION 5
+
+struct partial_result_tag {
+  uint64_t scenario_hash;
+  uint64_t seed;
+  uint64_t run_trials;   /* trials of the whole run, over every shard */
+  uint32_t sampling;     /* SIM_STRATIFIED and/or SIM_ANTITHETIC */
+  uint32_t n_shards;
+  size_t n_covered;
+  uint32_t *shards;   /* the n_covered shards counted in res, in order */
+  sim_result_t *res;
+};
+typedef struct partial_result_tag partial_result_t;
+
+int write_partial_result(const char *path, const partial_result_t *part);
+partial_result_t *read_partial_result(const char *path);
+int merge_partial_result(partial_result_t *total, const partial_result_t *part);
+void free_partial_result(partial_result_t *part);
+#endif
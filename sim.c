@@ -0,0 +1,1018 @@
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "cardset.h"
+#include "pool.h"
+#include "rng.h"
+#include "scenario.h"
+#include "sim.h"
+#include "strength.h"
+
+/* The read-only layout of a scenario that every simulation thread shares.
+ *
+ * Cards and unknown cards (?n) held by every hand form the board. Each trial
+ * draws one card per used ?n index into draws; the board's unknown cards
+ * are drawn first, so the board is put together once per trial and each
+ * hand then only adds its own cards. The hands of SIM_EVAL_TRIALS trials
+ * are evaluated together by cardset_strengths before their showdowns are
+ * counted; each hand is evaluated whole, as the batch kernels rebuild its
+ * rank masks from the suits in a few vector operations.
+ *
+ * A hand with a range first gets its hole cards: every trial picks one
+ * combination of each range with probability proportional to its weight,
+ * and starts over if two picks share a card, so the combinations are dealt
+ * with the right joint probabilities. The unknown cards are then drawn from
+ * the rest of the deck. Combinations that hold a known card are dropped
+ * from the plan.
+ *
+ * Stratified and antithetic sampling keep the remaining cards in order of
+ * rank. Stratified sampling gives the first draw of trial i (or of pair
+ * i / 2) remaining card i modulo the number of remaining cards, so every
+ * card is drawn first equally often. Antithetic sampling gives trial 2k + 1
+ * the random numbers of trial 2k, each r of them in [0, m) replaced by
+ * m - 1 - r, so where one trial draws low cards its partner tends to draw
+ * high ones. A batch is one pair, one cycle through the remaining cards, or
+ * one cycle of pairs. Scenarios with ranges are always sampled plainly.
+ */
+struct sim_plan_tag {
+  size_t n_hands;
+  cardset_t board_known;      /* known cards every hand holds */
+  cardset_t *private_known;   /* each hand's other known cards */
+  size_t n_draws;             /* used ?n indices */
+  size_t n_board_draws;       /* of which the first n_board_draws are shared */
+  size_t *draw_start;         /* hand h's own draws are hand_draws[draw_start[h]] */
+  unsigned char *hand_draws;  /* up to hand_draws[draw_start[h + 1] - 1] */
+  unsigned char remaining[DECK_SIZE];
+  size_t n_remaining;
+  int stratified;             /* trial i's first draw is stratum_card(i) */
+  int antithetic;             /* odd trials mirror the draws of the even ones */
+  unsigned long long batch_size;  /* trials per batch, or 0 for plain sampling */
+  int has_ranges;
+  size_t *n_combos;           /* hand h's usable range combinations, or 0 */
+  cardset_t **combos;         /* combos[h][i], i < n_combos[h] */
+  unsigned **cumulative;      /* cumulative[h][i]: weights of combos[h][0..i] */
+};
+typedef struct sim_plan_tag sim_plan_t;
+
+/* How many times in a row a trial may fail to deal the ranges disjoint
+ * combinations before the simulation gives up.
+ */
+#define SIM_MAX_REJECTS 1000000
+
+/* Trials whose hands a worker evaluates in one call to cardset_strengths. */
+#define SIM_EVAL_TRIALS 16
+
+/* Everything one simulation thread changes: its own copy of the remaining
+ * deck, its generator and its counts. The threads share nothing writable
+ * while they run and their counts are merged once they have all finished.
+ *
+ * Trial i draws from Philox stream i of the seed, starting from the deck in
+ * plan order (each trial undoes its swaps), so its cards depend on nothing
+ * but the seed and i: the counts of trials 0 to n - 1 are the same however
+ * they are split over threads, rounds or shards.
+ */
+struct sim_worker_tag {
+  const sim_plan_t *plan;
+  unsigned char deck[DECK_SIZE];
+  unsigned char swaps[DECK_SIZE];  /* where each drawn card came from */
+  cardset_t *sets;                 /* [trial * n_hands + h]: the pending trials' hands */
+  hand_strength_t *strengths;      /* their strengths, likewise */
+  size_t n_pending;                /* trials dealt but not yet counted */
+  cardset_t *holes;  /* hole cards dealt from each hand's range */
+  unsigned long long *batch_base;  /* the counts when the current batch began */
+  int in_batch;                    /* the current batch began in this round */
+  uint64_t seed;
+  unsigned long long first_trial;
+  unsigned long long n_trials;
+  sim_result_t *res;
+  int failed;
+};
+typedef struct sim_worker_tag sim_worker_t;
+
+sim_result_t *init_sim_result(size_t n_hands)
+{
+  sim_result_t *res = malloc(sizeof(*res));
+  if (res == NULL)
+  {
+    fprintf(stderr, "Failed to allocate memory for results. Error: %d\n", errno);
+    return NULL;
+  }
+  res->n_hands = n_hands;
+  res->n_trials = 0;
+  res->exact = 0;
+  res->batch_size = 0;
+  res->n_batches = 0;
+  res->batch_sums = NULL;
+  res->batch_squares = NULL;
+  res->wins = calloc(n_hands, sizeof(*res->wins));
+  res->ties = calloc(n_hands, sizeof(*res->ties));
+  res->split_ties = calloc(n_hands * (n_hands - 1) + 1, sizeof(*res->split_ties));
+  if (res->wins == NULL || res->ties == NULL || res->split_ties == NULL)
+  {
+    fprintf(stderr, "Failed to allocate memory for results. Error: %d\n", errno);
+    free_sim_result(res);
+    return NULL;
+  }
+  return res;
+}
+
+int track_batches(sim_result_t *res, unsigned long long batch_size)
+/* Starts counting batches of batch_size trials in res. Returns 0 on
+ * success.
+ */
+{
+  res->batch_sums = calloc(2 * res->n_hands, sizeof(*res->batch_sums));
+  res->batch_squares = calloc(2 * res->n_hands, sizeof(*res->batch_squares));
+  if (res->batch_sums == NULL || res->batch_squares == NULL)
+  {
+    fprintf(stderr, "Failed to allocate memory for results. Error: %d\n", errno);
+    return -1;
+  }
+  res->batch_size = batch_size;
+  res->n_batches = 0;
+  return 0;
+}
+
+void clear_sim_result(sim_result_t *res)
+{
+  res->n_trials = 0;
+  for (size_t i = 0; i < res->n_hands; ++i)
+  {
+    res->wins[i] = 0;
+    res->ties[i] = 0;
+  }
+  for (size_t i = 0; i < res->n_hands * (res->n_hands - 1); ++i)
+  {
+    res->split_ties[i] = 0;
+  }
+  res->n_batches = 0;
+  for (size_t i = 0; res->batch_size > 0 && i < 2 * res->n_hands; ++i)
+  {
+    res->batch_sums[i] = 0;
+    res->batch_squares[i] = 0;
+  }
+}
+
+void add_sim_result(sim_result_t *total, sim_result_t *part)
+/* Adds the counts of part to total. The batches are only added if both
+ * count batches of the same size.
+ */
+{
+  total->n_trials += part->n_trials;
+  for (size_t i = 0; i < total->n_hands; ++i)
+  {
+    total->wins[i] += part->wins[i];
+    total->ties[i] += part->ties[i];
+  }
+  for (size_t i = 0; i < total->n_hands * (total->n_hands - 1); ++i)
+  {
+    total->split_ties[i] += part->split_ties[i];
+  }
+  if (total->batch_size == 0 || part->batch_size != total->batch_size) return;
+  total->n_batches += part->n_batches;
+  for (size_t i = 0; i < 2 * total->n_hands; ++i)
+  {
+    total->batch_sums[i] += part->batch_sums[i];
+    total->batch_squares[i] += part->batch_squares[i];
+  }
+}
+
+void print_sim_result(FILE *f, sim_result_t *res, deck_t **hands, future_cards_t *fc)
+/* Prints a line per hand, followed by the hand as its input wrote it (see
+ * fprint_future_hand) if hands is not NULL; fc holds its placeholders.
+ */
+{
+  unsigned long long n = res->n_trials;
+  for (size_t i = 0; i < res->n_hands; ++i)
+  {
+    fprintf(f, "Hand %zu won %llu / %llu times (%.2f%%), tied %llu times (%.2f%%), "
+            "equity %.2f%%",
+            i, res->wins[i], n, n ? 100.0 * res->wins[i] / n : 0.0,
+            res->ties[i], n ? 100.0 * res->ties[i] / n : 0.0, 100 * sim_result_equity(res, i));
+    if (hands != NULL)
+    {
+      fprintf(f, ": ");
+      fprint_future_hand(f, hands[i], fc);
+    }
+    fprintf(f, "\n");
+  }
+}
+
+void free_sim_result(sim_result_t *res)
+{
+  if (res == NULL) return;
+  free(res->wins);
+  free(res->ties);
+  free(res->split_ties);
+  free(res->batch_sums);
+  free(res->batch_squares);
+  free(res);
+}
+
+unsigned default_thread_count(void)
+{
+  long n = sysconf(_SC_NPROCESSORS_ONLN);
+  return n > 0 ? (unsigned) n : 1;
+}
+
+void record_showdown(hand_strength_t *strengths, size_t n_hands, unsigned long long weight,
+                     sim_result_t *res)
+/* Credits the best hand(s) among strengths with weight wins, or with weight
+ * ties each, split n_best ways, if n_best > 1 hands hold the best strength,
+ * and counts weight trials. Enumeration weights an outcome by how many
+ * outcomes it stands for.
+ */
+{
+  size_t n_best;
+  hand_strength_t best = best_strength(strengths, n_hands, &n_best);
+  for (size_t i = 0; i < n_hands; ++i)
+  {
+    if (strengths[i] == best)
+    {
+      if (n_best == 1)
+      {
+        res->wins[i] += weight;
+      }
+      else
+      {
+        res->ties[i] += weight;
+        res->split_ties[split_index(n_hands, i, n_best)] += weight;
+      }
+    }
+  }
+  res->n_trials += weight;
+}
+
+static void free_sim_plan(sim_plan_t *plan)
+{
+  if (plan == NULL) return;
+  for (size_t h = 0; plan->combos != NULL && h < plan->n_hands; ++h)
+  {
+    free(plan->combos[h]);
+    free(plan->cumulative[h]);
+  }
+  free(plan->n_combos);
+  free(plan->combos);
+  free(plan->cumulative);
+  free(plan->private_known);
+  free(plan->draw_start);
+  free(plan->hand_draws);
+  free(plan);
+}
+
+static int add_plan_ranges(sim_plan_t *plan, scenario_t *sc)
+/* Copies the combinations of every range that hold no known card, with
+ * their running weight totals. Returns 0 on success, and -1 on error or if
+ * the ranges cannot all be dealt at once.
+ */
+{
+  size_t n_hands = sc->n_hands;
+  plan->n_combos = calloc(n_hands, sizeof(*plan->n_combos));
+  plan->combos = calloc(n_hands, sizeof(*plan->combos));
+  plan->cumulative = calloc(n_hands, sizeof(*plan->cumulative));
+  if (plan->n_combos == NULL || plan->combos == NULL || plan->cumulative == NULL)
+  {
+    fprintf(stderr, "Failed to allocate memory for simulation. Error: %d\n", errno);
+    return -1;
+  }
+  plan->has_ranges = 1;
+  for (size_t h = 0; h < n_hands; ++h)
+  {
+    const range_t *range = sc->ranges[h];
+    if (range == NULL) continue;
+    plan->combos[h] = malloc(sizeof(**plan->combos) * range->n_combos);
+    plan->cumulative[h] = malloc(sizeof(**plan->cumulative) * range->n_combos);
+    if (plan->combos[h] == NULL || plan->cumulative[h] == NULL)
+    {
+      fprintf(stderr, "Failed to allocate memory for simulation. Error: %d\n", errno);
+      return -1;
+    }
+    unsigned total = 0;
+    size_t n = 0;
+    for (size_t i = 0; i < range->n_combos; ++i)
+    {
+      if (range->combos[i] & sc->dead) continue;
+      total += range->weights[i];
+      plan->combos[h][n] = range->combos[i];
+      plan->cumulative[h][n] = total;
+      ++n;
+    }
+    if (n == 0)
+    {
+      fprintf(stderr, "Every combination in the range of hand %zu holds a known card.\n", h);
+      return -1;
+    }
+    plan->n_combos[h] = n;
+  }
+  if (!ranges_can_deal(sc->ranges, n_hands, sc->dead))
+  {
+    fprintf(stderr, "The ranges cannot all be dealt combinations without sharing a card.\n");
+    return -1;
+  }
+  return 0;
+}
+
+static int by_rank(const void *a, const void *b)
+{
+  unsigned x = *(const unsigned char *) a;
+  unsigned y = *(const unsigned char *) b;
+  return (int) (x % 13 * NUM_SUITS + x / 13) - (int) (y % 13 * NUM_SUITS + y / 13);
+}
+
+static sim_plan_t *make_sim_plan(scenario_t *sc, unsigned sampling)
+{
+  size_t n_hands = sc->n_hands;
+  sim_plan_t *plan = calloc(1, sizeof(*plan));
+  if (plan != NULL)
+  {
+    plan->private_known = malloc(sizeof(*plan->private_known) * (n_hands + 1));
+    plan->draw_start = malloc(sizeof(*plan->draw_start) * (n_hands + 1));
+    plan->hand_draws = malloc(n_hands * sc->n_slots + 1);
+  }
+  if (plan == NULL || plan->private_known == NULL || plan->draw_start == NULL ||
+      plan->hand_draws == NULL)
+  {
+    fprintf(stderr, "Failed to allocate memory for simulation. Error: %d\n", errno);
+    free_sim_plan(plan);
+    return NULL;
+  }
+  plan->n_hands = n_hands;
+  if (scenario_has_ranges(sc) && add_plan_ranges(plan, sc) != 0)
+  {
+    free_sim_plan(plan);
+    return NULL;
+  }
+  plan->board_known = n_hands > 0 ? CARDSET_FULL : CARDSET_EMPTY;
+  for (size_t h = 0; h < n_hands; ++h)
+  {
+    plan->board_known &= sc->known[h];
+  }
+  for (size_t h = 0; h < n_hands; ++h)
+  {
+    plan->private_known[h] = sc->known[h] & ~plan->board_known;
+  }
+
+  /* Number the used ?n indices, the ones every hand holds first. */
+  size_t draw_of[DECK_SIZE];
+  for (int board = 1; board >= 0; --board)
+  {
+    for (size_t s = 0; s < sc->n_slots && s < DECK_SIZE; ++s)
+    {
+      if (!slot_is_used(sc, s)) continue;
+      int shared = 1;
+      for (size_t h = 0; h < n_hands; ++h)
+      {
+        if (!scenario_uses(sc, h, s)) shared = 0;
+      }
+      if (shared == board)
+      {
+        draw_of[s] = plan->n_draws++;
+        if (board) ++plan->n_board_draws;
+      }
+    }
+  }
+  size_t n = 0;
+  for (size_t h = 0; h < n_hands; ++h)
+  {
+    plan->draw_start[h] = n;
+    for (size_t s = 0; s < sc->n_slots && s < DECK_SIZE; ++s)
+    {
+      if (scenario_uses(sc, h, s) && draw_of[s] >= plan->n_board_draws)
+      {
+        plan->hand_draws[n++] = draw_of[s];
+      }
+    }
+  }
+  plan->draw_start[n_hands] = n;
+
+  cardset_t left = cardset_complement(sc->dead);
+  while (left != CARDSET_EMPTY)
+  {
+    plan->remaining[plan->n_remaining++] = __builtin_ctzll(left);
+    left &= left - 1;
+  }
+  size_t n_hole_cards = 0;
+  for (size_t h = 0; plan->has_ranges && h < n_hands; ++h)
+  {
+    if (plan->n_combos[h] > 0) n_hole_cards += 2;
+  }
+  if (plan->n_draws + n_hole_cards > plan->n_remaining)
+  {
+    fprintf(stderr, "Not enough cards left in the deck for %zu unknown cards.\n", plan->n_draws);
+    free_sim_plan(plan);
+    return NULL;
+  }
+  if (plan->has_ranges || plan->n_draws == 0) sampling = SIM_PLAIN;
+  plan->stratified = (sampling & SIM_STRATIFIED) != 0;
+  plan->antithetic = (sampling & SIM_ANTITHETIC) != 0;
+  if (sampling != SIM_PLAIN)
+  {
+    qsort(plan->remaining, plan->n_remaining, 1, by_rank);
+    plan->batch_size = (plan->stratified ? plan->n_remaining : 1) * (plan->antithetic ? 2 : 1);
+  }
+  return plan;
+}
+
+static void draw_cards(unsigned char *deck, unsigned char *swaps, size_t n_cards, size_t k,
+                       long first, int mirror, philox_t *rng)
+/* Moves a uniform random draw of k cards to the front of deck (the first k
+ * steps of a Fisher-Yates shuffle, as partial_shuffle does for a deck_t),
+ * noting in swaps where each one came from. If first is not negative, the
+ * first card is deck[first] instead of a random one; if mirror is set, each
+ * random choice r of m is replaced with m - 1 - r.
+ */
+{
+  for (size_t i = 0; i < k; ++i)
+  {
+    size_t j;
+    if (i == 0 && first >= 0)
+    {
+      j = first;
+    }
+    else
+    {
+      size_t r = philox_bounded(rng, n_cards - i);
+      j = i + (mirror ? n_cards - i - 1 - r : r);
+    }
+    swaps[i] = j;
+    unsigned char temp = deck[j];
+    deck[j] = deck[i];
+    deck[i] = temp;
+  }
+}
+
+static void draw_cards_avoiding(unsigned char *deck, unsigned char *swaps, size_t n_cards,
+                                size_t k, cardset_t avoid, philox_t *rng)
+/* Like draw_cards, but never draws a card in avoid. A card in avoid is
+ * never moved to the front, so each step draws uniformly from the cards not
+ * yet drawn and not avoided.
+ */
+{
+  for (size_t i = 0; i < k; ++i)
+  {
+    size_t j;
+    do
+    {
+      j = i + philox_bounded(rng, n_cards - i);
+    } while (cardset_from_num(deck[j]) & avoid);
+    swaps[i] = j;
+    unsigned char temp = deck[j];
+    deck[j] = deck[i];
+    deck[i] = temp;
+  }
+}
+
+static void undraw_cards(unsigned char *deck, const unsigned char *swaps, size_t k)
+/* Undoes draw_cards, putting deck back in the order it had before. */
+{
+  for (size_t i = k; i-- > 0;)
+  {
+    unsigned char temp = deck[swaps[i]];
+    deck[swaps[i]] = deck[i];
+    deck[i] = temp;
+  }
+}
+
+static cardset_t pick_combo(const sim_plan_t *plan, size_t h, philox_t *rng)
+/* Picks one of hand h's combinations with probability proportional to its
+ * weight.
+ */
+{
+  size_t n = plan->n_combos[h];
+  const unsigned *cumulative = plan->cumulative[h];
+  unsigned x = philox_bounded(rng, cumulative[n - 1]);
+  size_t lo = 0;
+  size_t hi = n - 1;
+  while (lo < hi)
+  {
+    size_t mid = (lo + hi) / 2;
+    if (cumulative[mid] > x) hi = mid;
+    else lo = mid + 1;
+  }
+  return plan->combos[h][lo];
+}
+
+static int deal_ranges(const sim_plan_t *plan, cardset_t *holes, cardset_t *taken,
+                       philox_t *rng)
+/* Deals every hand with a range a combination from it, no two sharing a
+ * card, into holes, and sets taken to all of them. Returns -1 if that
+ * failed SIM_MAX_REJECTS times in a row.
+ */
+{
+  for (unsigned tries = 0; tries < SIM_MAX_REJECTS; ++tries)
+  {
+    cardset_t dealt = CARDSET_EMPTY;
+    size_t h;
+    for (h = 0; h < plan->n_hands; ++h)
+    {
+      if (plan->n_combos[h] == 0) continue;
+      holes[h] = pick_combo(plan, h, rng);
+      if (holes[h] & dealt) break;
+      dealt |= holes[h];
+    }
+    if (h == plan->n_hands)
+    {
+      *taken = dealt;
+      return 0;
+    }
+  }
+  fprintf(stderr, "The ranges overlap too much to deal them hole cards.\n");
+  return -1;
+}
+
+static void count_pending(sim_worker_t *w)
+/* Evaluates the hands of the pending trials and counts their showdowns. */
+{
+  size_t n_hands = w->plan->n_hands;
+  cardset_strengths(w->sets, w->n_pending * n_hands, w->strengths);
+  for (size_t t = 0; t < w->n_pending; ++t)
+  {
+    record_showdown(w->strengths + t * n_hands, n_hands, 1, w->res);
+  }
+  w->n_pending = 0;
+}
+
+static void begin_batch(sim_worker_t *w)
+{
+  for (size_t h = 0; h < w->plan->n_hands; ++h)
+  {
+    w->batch_base[2 * h] = w->res->wins[h];
+    w->batch_base[2 * h + 1] = w->res->ties[h];
+  }
+  w->in_batch = 1;
+}
+
+static void end_batch(sim_worker_t *w)
+/* Adds the counts of the batch just finished to the worker's batches. */
+{
+  sim_result_t *res = w->res;
+  for (size_t h = 0; h < w->plan->n_hands; ++h)
+  {
+    unsigned long long wins = res->wins[h] - w->batch_base[2 * h];
+    unsigned long long ties = res->ties[h] - w->batch_base[2 * h + 1];
+    res->batch_sums[2 * h] += wins;
+    res->batch_squares[2 * h] += wins * wins;
+    res->batch_sums[2 * h + 1] += ties;
+    res->batch_squares[2 * h + 1] += ties * ties;
+  }
+  ++res->n_batches;
+}
+
+static void *sim_worker_run(void *arg)
+{
+  sim_worker_t *w = arg;
+  const sim_plan_t *plan = w->plan;
+  unsigned char *draws = w->deck;
+  unsigned long long batch_size = plan->batch_size;
+  w->in_batch = 0;
+  for (unsigned long long t = 0; t < w->n_trials; ++t)
+  {
+    unsigned long long trial = w->first_trial + t;
+    unsigned long long unit = plan->antithetic ? trial / 2 : trial;
+    int mirror = plan->antithetic && (trial & 1);
+    philox_t rng;
+    philox_start(&rng, w->seed, unit);
+    if (batch_size > 0 && trial % batch_size == 0)
+    {
+      count_pending(w);
+      begin_batch(w);
+    }
+    if (plan->has_ranges)
+    {
+      cardset_t taken;
+      if (deal_ranges(plan, w->holes, &taken, &rng) != 0)
+      {
+        w->failed = 1;
+        return NULL;
+      }
+      draw_cards_avoiding(w->deck, w->swaps, plan->n_remaining, plan->n_draws, taken, &rng);
+    }
+    else
+    {
+      long first = -1;
+      if (plan->stratified)
+      {
+        first = unit % plan->n_remaining;
+        if (mirror) first = plan->n_remaining - 1 - first;
+      }
+      draw_cards(w->deck, w->swaps, plan->n_remaining, plan->n_draws, first, mirror, &rng);
+    }
+    cardset_t board = plan->board_known;
+    for (size_t d = 0; d < plan->n_board_draws; ++d)
+    {
+      board |= cardset_from_num(draws[d]);
+    }
+    cardset_t *sets = w->sets + w->n_pending * plan->n_hands;
+    for (size_t h = 0; h < plan->n_hands; ++h)
+    {
+      cardset_t own = plan->private_known[h] | w->holes[h];
+      for (size_t i = plan->draw_start[h]; i < plan->draw_start[h + 1]; ++i)
+      {
+        own |= cardset_from_num(draws[plan->hand_draws[i]]);
+      }
+      sets[h] = board | own;
+    }
+    undraw_cards(w->deck, w->swaps, plan->n_draws);
+    if (++w->n_pending == SIM_EVAL_TRIALS) count_pending(w);
+    if (w->in_batch && trial % batch_size == batch_size - 1)
+    {
+      count_pending(w);
+      end_batch(w);
+    }
+  }
+  count_pending(w);
+  return NULL;
+}
+
+static void free_sim_worker(sim_worker_t *w)
+{
+  free(w->sets);
+  free(w->strengths);
+  free(w->holes);
+  free(w->batch_base);
+  free_sim_result(w->res);
+}
+
+static int init_sim_worker(sim_worker_t *w, const sim_plan_t *plan, uint64_t seed)
+/* Gives the worker its own copy of the remaining deck. Returns 0 on success. */
+{
+  memset(w, 0, sizeof(*w));
+  w->plan = plan;
+  w->seed = seed;
+  memcpy(w->deck, plan->remaining, plan->n_remaining);
+  w->sets = malloc(sizeof(*w->sets) * (SIM_EVAL_TRIALS * plan->n_hands + 1));
+  w->strengths = malloc(sizeof(*w->strengths) * (SIM_EVAL_TRIALS * plan->n_hands + 1));
+  w->holes = calloc(plan->n_hands + 1, sizeof(*w->holes));
+  w->batch_base = calloc(2 * plan->n_hands + 1, sizeof(*w->batch_base));
+  w->res = init_sim_result(plan->n_hands);
+  if (w->sets == NULL || w->strengths == NULL || w->holes == NULL || w->batch_base == NULL ||
+      w->res == NULL ||
+      (plan->batch_size > 0 && track_batches(w->res, plan->batch_size) != 0))
+  {
+    fprintf(stderr, "Failed to allocate memory for simulation thread. Error: %d\n", errno);
+    free_sim_worker(w);
+    return -1;
+  }
+  return 0;
+}
+
+/* The workers of one simulation, kept together so that the trials can be
+ * run in several rounds without setting them up again.
+ */
+struct sim_run_tag {
+  sim_plan_t *plan;
+  sim_worker_t *workers;
+  unsigned n_threads;
+  unsigned long long next_trial;  /* index of the next trial to run */
+};
+typedef struct sim_run_tag sim_run_t;
+
+static void end_sim_run(sim_run_t *run)
+{
+  for (unsigned i = 0; i < run->n_threads; ++i)
+  {
+    free_sim_worker(&run->workers[i]);
+  }
+  free(run->workers);
+  free_sim_plan(run->plan);
+  free(run);
+}
+
+static sim_run_t *start_sim_run(scenario_t *sc, unsigned n_threads, uint64_t seed,
+                                unsigned long long first_trial, unsigned sampling,
+                                sim_result_t *total)
+/* Sets up n_threads workers for the trials of seed from first_trial on,
+ * whose counts are to be gathered in total.
+ */
+{
+  init_strength_tables();
+  sim_plan_t *plan = make_sim_plan(sc, sampling);
+  if (plan == NULL) return NULL;
+  if (plan->batch_size > 0 && track_batches(total, plan->batch_size) != 0)
+  {
+    free_sim_plan(plan);
+    return NULL;
+  }
+  sim_run_t *run = malloc(sizeof(*run));
+  if (run == NULL)
+  {
+    fprintf(stderr, "Failed to allocate memory for simulation. Error: %d\n", errno);
+    free_sim_plan(plan);
+    return NULL;
+  }
+  run->plan = plan;
+  run->n_threads = 0;
+  run->next_trial = first_trial;
+  run->workers = calloc(n_threads, sizeof(*run->workers));
+  if (run->workers == NULL)
+  {
+    fprintf(stderr, "Failed to allocate memory for simulation. Error: %d\n", errno);
+    end_sim_run(run);
+    return NULL;
+  }
+  for (unsigned i = 0; i < n_threads; ++i)
+  {
+    if (init_sim_worker(&run->workers[i], plan, seed) != 0)
+    {
+      end_sim_run(run);
+      return NULL;
+    }
+    ++run->n_threads;
+  }
+  return run;
+}
+
+static int run_sim_round(sim_run_t *run, unsigned long long n_trials, sim_result_t *total)
+/* Runs the next n_trials trials, each worker a consecutive block of them,
+ * then sets total to the counts of every trial run so far. Returns 0 on
+ * success. The blocks start at batch boundaries where they can, so that
+ * few batches are split between workers and left uncounted.
+ */
+{
+  unsigned n_threads = run->n_threads;
+  unsigned long long batch_size = run->plan->batch_size;
+  unsigned long long start = run->next_trial;
+  unsigned long long end = start + n_trials;
+  for (unsigned i = 0; i < n_threads; ++i)
+  {
+    unsigned long long extra = n_trials % n_threads;
+    unsigned long long next = start + n_trials / n_threads * (i + 1) + (i < extra ? i + 1 : extra);
+    if (i == n_threads - 1)
+    {
+      next = end;
+    }
+    else if (batch_size > 0)
+    {
+      unsigned long long aligned = (next + batch_size / 2) / batch_size * batch_size;
+      if (aligned >= run->next_trial && aligned <= end) next = aligned;
+    }
+    run->workers[i].first_trial = run->next_trial;
+    run->workers[i].n_trials = next - run->next_trial;
+    run->next_trial = next;
+  }
+  int failed = run_parallel(sim_worker_run, run->workers, sizeof(*run->workers), n_threads) != 0;
+  clear_sim_result(total);
+  for (unsigned i = 0; i < n_threads; ++i)
+  {
+    add_sim_result(total, run->workers[i].res);
+    if (run->workers[i].failed) failed = 1;
+  }
+  return failed ? -1 : 0;
+}
+
+sim_result_t *simulate_scenario(scenario_t *sc, unsigned long long n_trials,
+                                unsigned n_threads, uint64_t seed)
+/*
+   Runs n_trials Monte Carlo trials of the scenario on n_threads threads (0
+   picks one per online processor) and returns the merged counts, or NULL on
+   error. Each trial draws one card from the remaining deck for every used
+   ?n index and compares every hand. The scenario is only read.
+*/
+{
+  return simulate_shard(sc, n_trials, n_threads, seed, 0, 1, SIM_PLAIN);
+}
+
+unsigned long long shard_trials(unsigned long long n_trials, unsigned shard, unsigned n_shards)
+/* The number of the n_trials trials that shard runs. The shares of the
+ * n_shards shards add up to n_trials.
+ */
+{
+  unsigned long long share = n_trials / n_shards;
+  return share + (shard < n_trials % n_shards);
+}
+
+static unsigned long long shard_first_trial(unsigned long long n_trials, unsigned shard,
+                                            unsigned n_shards)
+/* The index of the first trial that shard runs. */
+{
+  unsigned long long share = n_trials / n_shards;
+  unsigned long long extra = n_trials % n_shards;
+  return share * shard + (shard < extra ? shard : extra);
+}
+
+sim_result_t *simulate_shard(scenario_t *sc, unsigned long long n_trials, unsigned n_threads,
+                             uint64_t seed, unsigned shard, unsigned n_shards,
+                             unsigned sampling)
+/*
+   Runs shard's share (see shard_trials) of a simulation of n_trials trials
+   split over n_shards processes, as simulate_scenario does but with the
+   given sampling strategies. The shards run consecutive blocks of the
+   trials, so add_sim_result of all of them gives exactly the counts of the
+   unsharded simulation with the same seed.
+*/
+{
+  unsigned long long first_trial = shard_first_trial(n_trials, shard, n_shards);
+  n_trials = shard_trials(n_trials, shard, n_shards);
+  if (n_threads == 0) n_threads = default_thread_count();
+  if (n_threads > n_trials) n_threads = n_trials > 0 ? n_trials : 1;
+  sim_result_t *total = init_sim_result(sc->n_hands);
+  sim_run_t *run = total != NULL ? start_sim_run(sc, n_threads, seed, first_trial, sampling, total)
+                                     : NULL;
+  if (run == NULL || run_sim_round(run, n_trials, total) != 0)
+  {
+    if (run != NULL) end_sim_run(run);
+    free_sim_result(total);
+    return NULL;
+  }
+  end_sim_run(run);
+  return total;
+}
+
+sim_result_t *run_simulation(deck_t **hands, size_t n_hands, future_cards_t *fc,
+                             unsigned long long n_trials, unsigned n_threads,
+                             uint64_t seed)
+/* simulate_scenario for parsed hands and the placeholders in fc, which are
+ * only read, never modified.
+ */
+{
+  scenario_t *sc = compile_scenario(hands, n_hands, fc);
+  if (sc == NULL) return NULL;
+  sim_result_t *res = simulate_scenario(sc, n_trials, n_threads, seed);
+  free_scenario(sc);
+  return res;
+}
+
+static double proportion_half_width(unsigned long long x, unsigned long long n)
+/* Half-width of the 95% Agresti-Coull interval for x successes in n trials.
+ * Unlike the plain normal interval it does not collapse to zero when a hand
+ * has not (yet) won or tied at all.
+ */
+{
+  double z2 = SIM_Z * SIM_Z;
+  double nt = n + z2;
+  double p = (x + z2 / 2) / nt;
+  return SIM_Z * sqrt(p * (1 - p) / nt);
+}
+
+double sim_result_variance_factor(sim_result_t *res)
+/* Returns how many times smaller the variance of res's win and tie counts
+ * is than that of as many independent trials, estimated from the spread of
+ * the counts of its batches, or 0 if it has fewer than two batches. The
+ * estimate is capped at the number of batches, which cannot show a larger
+ * one.
+ */
+{
+  if (res->batch_size == 0 || res->n_batches < 2) return 0;
+  double size = res->batch_size;
+  double n = res->n_batches;
+  double independent = 0;
+  double actual = 0;
+  for (size_t i = 0; i < 2 * res->n_hands; ++i)
+  {
+    double mean = res->batch_sums[i] / n;
+    double p = mean / size;
+    independent += size * p * (1 - p);
+    actual += (res->batch_squares[i] - n * mean * mean) / (n - 1);
+  }
+  if (independent <= 0) return 1;
+  return independent / (actual > independent / n ? actual : independent / n);
+}
+
+void print_variance_reduction(FILE *f, sim_result_t *res)
+/* Reports how much stratified or antithetic sampling helped, if it was
+ * used.
+ */
+{
+  double factor = sim_result_variance_factor(res);
+  if (factor > 0)
+  {
+    fprintf(f, "Variance reduced %.2fx over %llu batches: as precise as %.0f plain trials\n",
+            factor, res->n_batches, factor * res->n_trials);
+  }
+}
+
+static double reliable_factor(sim_result_t *res)
+/* sim_result_variance_factor once there are enough batches to rely on it,
+ * 1 otherwise.
+ */
+{
+  if (res->n_batches < SIM_MIN_BATCHES) return 1;
+  return sim_result_variance_factor(res);
+}
+
+double sim_result_equity(sim_result_t *res, size_t h)
+/* Hand h's share of the pots: a win takes the whole pot and a tie between
+ * k hands a k-th of it.
+ */
+{
+  if (res->n_trials == 0) return 0;
+  double shares = res->wins[h];
+  for (size_t k = 2; k <= res->n_hands; ++k)
+  {
+    shares += (double) res->split_ties[split_index(res->n_hands, h, k)] / k;
+  }
+  return shares / res->n_trials;
+}
+
+double sim_result_half_width(sim_result_t *res)
+/* The widest 95% confidence half-width of any hand's win or tie rate,
+ * narrowed by the variance reduction of stratified or antithetic sampling.
+ */
+{
+  double widest = 0;
+  for (size_t i = 0; i < res->n_hands; ++i)
+  {
+    double w = proportion_half_width(res->wins[i], res->n_trials);
+    double t = proportion_half_width(res->ties[i], res->n_trials);
+    if (w > widest) widest = w;
+    if (t > widest) widest = t;
+  }
+  return widest / sqrt(reliable_factor(res));
+}
+
+int sim_result_suffices(sim_result_t *res, int need_exact,
+                        unsigned long long min_trials, double tolerance)
+/* Returns 1 if res can stand in for a new run: an exact result always can;
+ * when need_exact is 0, so can a sample of at least min_trials trials or
+ * (if tolerance is positive) one whose 95% confidence intervals are within
+ * +/- tolerance.
+ */
+{
+  if (res->exact) return 1;
+  if (need_exact) return 0;
+  if (res->n_trials >= min_trials) return 1;
+  return tolerance > 0 && sim_result_half_width(res) <= tolerance;
+}
+
+static unsigned long long trials_needed(sim_result_t *res, double tolerance)
+/* Estimates the total number of trials after which every win and tie rate,
+ * at its current estimate, has a half-width of at most tolerance.
+ */
+{
+  double z2 = SIM_Z * SIM_Z;
+  double needed = 0;
+  for (size_t i = 0; i < res->n_hands; ++i)
+  {
+    unsigned long long counts[2] = { res->wins[i], res->ties[i] };
+    for (int k = 0; k < 2; ++k)
+    {
+      double p = (counts[k] + z2 / 2) / (res->n_trials + z2);
+      double n = z2 * p * (1 - p) / (tolerance * tolerance) - z2;
+      if (n > needed) needed = n;
+    }
+  }
+  needed /= reliable_factor(res);
+  return needed < 1e18 ? (unsigned long long) needed : 1000000000000000000ULL;
+}
+
+sim_result_t *simulate_scenario_until(scenario_t *sc, double tolerance,
+                                      unsigned long long max_trials,
+                                      unsigned n_threads, uint64_t seed, unsigned sampling)
+/*
+   Like simulate_scenario, but instead of a fixed trial count it runs rounds of
+   trials until the 95% confidence interval of every hand's win rate and tie
+   rate is within +/- tolerance (e.g. 0.005 for half a percentage point), or
+   max_trials trials have been run. sim_result_half_width of the result gives
+   the precision actually achieved.
+
+   The first round is small; each later round is sized from the current
+   estimates to reach the tolerance, with a small margin, so lopsided
+   scenarios stop after few trials.
+*/
+{
+  if (n_threads == 0) n_threads = default_thread_count();
+  if (n_threads > max_trials) n_threads = max_trials > 0 ? max_trials : 1;
+  sim_result_t *total = init_sim_result(sc->n_hands);
+  sim_run_t *run = total != NULL ? start_sim_run(sc, n_threads, seed, 0, sampling, total) : NULL;
+  if (run == NULL)
+  {
+    free_sim_result(total);
+    return NULL;
+  }
+  while (total->n_trials < max_trials &&
+         (total->n_trials == 0 || sim_result_half_width(total) > tolerance))
+  {
+    unsigned long long target = 0;
+    if (total->n_trials > 0)
+    {
+      target = trials_needed(total, tolerance);
+      target += target / 10;
+    }
+    if (target < total->n_trials + SIM_MIN_ROUND) target = total->n_trials + SIM_MIN_ROUND;
+    if (target > max_trials) target = max_trials;
+    if (run_sim_round(run, target - total->n_trials, total) != 0)
+    {
+      end_sim_run(run);
+      free_sim_result(total);
+      return NULL;
+    }
+  }
+  end_sim_run(run);
+  return total;
+}
+
+sim_result_t *run_simulation_until(deck_t **hands, size_t n_hands, future_cards_t *fc,
+                                   double tolerance, unsigned long long max_trials,
+                                   unsigned n_threads, uint64_t seed)
+/* simulate_scenario_until for parsed hands and the placeholders in fc. */
+{
+  scenario_t *sc = compile_scenario(hands, n_hands, fc);
+  if (sc == NULL) return NULL;
+  sim_result_t *res = simulate_scenario_until(sc, tolerance, max_trials, n_threads, seed,
+                                              SIM_PLAIN);
+  free_scenario(sc);
+  return res;
+}
@@ -0,0 +1,93 @@
+#ifndef SIM_H
+#define SIM_H
+#include "deck.h"
+#include "future.h"
+#include "scenario.h"
+#include "strength.h"
+
+/* Per-hand outcome counts of a simulation. A trial is a win for a hand when
+ * it alone holds the best hand, and a tie for every hand sharing the best
+ * hand. Exact enumerations use the same counts with one trial per outcome.
+ * Ties are also counted by how many hands split the pot, so that a hand's
+ * equity (its share of the pots) is exact in multi-way showdowns.
+ */
+struct sim_result_tag {
+  size_t n_hands;
+  unsigned long long n_trials;
+  int exact;  /* set by run_enumeration: every outcome counted once */
+  unsigned long long *wins;
+  unsigned long long *ties;
+  unsigned long long *split_ties;  /* [split_index(n_hands, h, k)]: ties in pots split k ways */
+  /* With stratified or antithetic sampling the trials come in batches whose
+   * counts vary less than independent trials would; batch_sums and
+   * batch_squares add up, over n_batches complete batches of batch_size
+   * trials, each hand's wins ([2 * h]) and ties ([2 * h + 1]) per batch and
+   * their squares. batch_size is 0 if batches are not tracked.
+   */
+  unsigned long long batch_size;
+  unsigned long long n_batches;
+  unsigned long long *batch_sums;
+  unsigned long long *batch_squares;
+};
+typedef struct sim_result_tag sim_result_t;
+
+static inline size_t split_index(size_t n_hands, size_t h, size_t k)
+/* Where split_ties counts hand h's ties in pots split k >= 2 ways: each
+ * hand has n_hands - 1 counts, for 2 to n_hands ways.
+ */
+{
+  return h * (n_hands - 1) + k - 2;
+}
+
+/* z-value of the 95% confidence intervals used for early stopping, and the
+ * smallest number of trials in each round. The rounds do not depend on the
+ * thread count, so with plain sampling neither does where the sampling
+ * stops. With stratified or antithetic sampling it can: the intervals are
+ * narrowed by the variance reduction estimated from the batches, and a
+ * batch split between two workers' blocks is not counted.
+ */
+#define SIM_Z 1.96
+#define SIM_MIN_ROUND 16000
+
+/* Sampling strategies for simulate_shard and simulate_scenario_until,
+ * combined with |. SIM_STRATIFIED cycles the first unknown card through
+ * every remaining card in turn; SIM_ANTITHETIC pairs each trial with one
+ * that makes the opposite random choices. The variance they achieve is only
+ * relied on once SIM_MIN_BATCHES batches have been counted.
+ */
+#define SIM_PLAIN 0
+#define SIM_STRATIFIED 1
+#define SIM_ANTITHETIC 2
+#define SIM_MIN_BATCHES 30
+
+sim_result_t *init_sim_result(size_t n_hands);
+void clear_sim_result(sim_result_t *res);
+void add_sim_result(sim_result_t *total, sim_result_t *part);
+int track_batches(sim_result_t *res, unsigned long long batch_size);
+double sim_result_variance_factor(sim_result_t *res);
+void print_variance_reduction(FILE *f, sim_result_t *res);
+double sim_result_half_width(sim_result_t *res);
+double sim_result_equity(sim_result_t *res, size_t h);
+int sim_result_suffices(sim_result_t *res, int need_exact,
+                        unsigned long long min_trials, double tolerance);
+void print_sim_result(FILE *f, sim_result_t *res, deck_t **hands, future_cards_t *fc);
+void free_sim_result(sim_result_t *res);
+unsigned default_thread_count(void);
+void record_showdown(hand_strength_t *strengths, size_t n_hands, unsigned long long weight,
+                     sim_result_t *res);
+sim_result_t *simulate_scenario(scenario_t *sc, unsigned long long n_trials,
+                                unsigned n_threads, uint64_t seed);
+unsigned long long shard_trials(unsigned long long n_trials, unsigned shard, unsigned n_shards);
+sim_result_t *simulate_shard(scenario_t *sc, unsigned long long n_trials, unsigned n_threads,
+                             uint64_t seed, unsigned shard, unsigned n_shards,
+                             unsigned sampling);
+sim_result_t *simulate_scenario_until(scenario_t *sc, double tolerance,
+                                      unsigned long long max_trials,
+                                      unsigned n_threads, uint64_t seed, unsigned sampling);
+sim_result_t *run_simulation(deck_t **hands, size_t n_hands, future_cards_t *fc,
+                             unsigned long long n_trials, unsigned n_threads,
+                             uint64_t seed);
+sim_result_t *run_simulation_until(deck_t **hands, size_t n_hands, future_cards_t *fc,
+                                   double tolerance, unsigned long long max_trials,
+                                   unsigned n_threads, uint64_t seed);
+#endif
@@ -0,0 +1,391 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include "cpu.h"
+#include "strength.h"
+
+/* Lookup table indexed by a 13-bit rank mask (bit 0 is a two, bit 12 an
+ * ace), built by init_strength_tables. The evaluators build it on first
+ * use if need be; tables_built is set, with release ordering, once it is
+ * complete, so checking it costs one plain load.
+ *
+ *   top_values[m]     the values of the (up to) five highest ranks in m,
+ *                     packed one per nibble with the highest in bits 16-19.
+ */
+#define N_RANK_MASKS (1 << 13)
+
+static uint32_t top_values[N_RANK_MASKS];
+static pthread_once_t tables_once = PTHREAD_ONCE_INIT;
+static int tables_built = 0;
+static cpu_level_t kernel_level = CPU_SCALAR;  /* of the batch kernels */
+
+/* Hands showdown evaluates with each call to cardset_strengths. */
+#define SHOWDOWN_BATCH 16
+
+static unsigned highest_value(unsigned mask)
+/* Value of the highest rank in a non-empty rank mask. */
+{
+  return 31 - __builtin_clz(mask) + 2;
+}
+
+static unsigned value_bit(unsigned value)
+{
+  return 1u << (value - 2);
+}
+
+static hand_strength_t make_strength(hand_ranking_t r, uint32_t values)
+{
+  return ((uint32_t) (NOTHING - r) << STRENGTH_CATEGORY_SHIFT) | values;
+}
+
+static uint32_t repeat_value(unsigned value, int n)
+/* Packs n copies of value into the top n nibbles of a five-value field. */
+{
+  uint32_t packed = 0;
+  for (int i = 0; i < n; ++i)
+  {
+    packed |= value << (4 * (4 - i));
+  }
+  return packed;
+}
+
+static uint32_t straight_values(unsigned high)
+/* The five values compare_hands sees for a straight: 5 4 3 2 A for the
+ * wheel, high .. high-4 otherwise.
+ */
+{
+  if (high == 5)
+  {
+    return (5 << 16) | (4 << 12) | (3 << 8) | (2 << 4) | VALUE_ACE;
+  }
+  uint32_t packed = 0;
+  for (int i = 0; i < 5; ++i)
+  {
+    packed |= (high - i) << (4 * (4 - i));
+  }
+  return packed;
+}
+
+static void build_strength_tables(void)
+/* Fills in the rank-mask lookup table and picks the batch kernels. */
+{
+  for (unsigned m = 0; m < N_RANK_MASKS; ++m)
+  {
+    uint32_t packed = 0;
+    unsigned rest = m;
+    for (int i = 0; i < 5 && rest != 0; ++i)
+    {
+      unsigned v = highest_value(rest);
+      packed |= v << (4 * (4 - i));
+      rest &= ~value_bit(v);
+    }
+    top_values[m] = packed;
+  }
+  kernel_level = cpu_level();
+  __atomic_store_n(&tables_built, 1, __ATOMIC_RELEASE);
+}
+
+void init_strength_tables(void)
+/* Builds the table on the first call; later calls, from any thread, wait
+ * for it and return. Calling it up front only saves the first evaluation
+ * the wait.
+ */
+{
+  pthread_once(&tables_once, build_strength_tables);
+}
+
+static inline void need_tables(void)
+{
+  if (!__atomic_load_n(&tables_built, __ATOMIC_ACQUIRE)) init_strength_tables();
+}
+
+void strength_state_init(strength_state_t *st, cardset_t set)
+/* Starts a state holding the cards in set. The per-suit rank masks are
+ * folded into masks of ranks held at least once, twice, three and four
+ * times, without branching on individual cards.
+ */
+{
+  unsigned ones = 0, twos = 0, threes = 0, fours = RANK_MASK_ALL;
+  for (int s = 0; s < NUM_SUITS; ++s)
+  {
+    unsigned suit = cardset_suit(set, s);
+    threes |= twos & suit;
+    twos |= ones & suit;
+    ones |= suit;
+    fours &= suit;
+  }
+  st->cards = set;
+  st->ones = ones;
+  st->twos = twos;
+  st->threes = threes;
+  st->fours = fours;
+}
+
+hand_strength_t strength_state_eval(const strength_state_t *st)
+/* Evaluates the best five-card poker hand among the cards in the state.
+ * Every category is read off the multiplicity masks and the tables.
+ */
+{
+  need_tables();
+  unsigned ones = st->ones, twos = st->twos, threes = st->threes, fours = st->fours;
+  unsigned flush = 0;
+  for (int s = 0; s < NUM_SUITS; ++s)
+  {
+    unsigned suit = cardset_suit(st->cards, s);
+    if (__builtin_popcount(suit) >= 5)
+    {
+      flush = suit;
+    }
+  }
+
+  unsigned high = flush ? rank_mask_straight_high(flush) : 0;
+  if (high)
+  {
+    return make_strength(STRAIGHT_FLUSH, straight_values(high));
+  }
+  if (fours)
+  {
+    unsigned q = highest_value(fours);
+    return make_strength(FOUR_OF_A_KIND,
+        repeat_value(q, 4) | (top_values[ones & ~value_bit(q)] >> 16));
+  }
+  if (threes)
+  {
+    unsigned t = highest_value(threes);
+    unsigned pairs = twos & ~value_bit(t);
+    if (pairs)
+    {
+      unsigned p = highest_value(pairs);
+      return make_strength(FULL_HOUSE, repeat_value(t, 3) | (repeat_value(p, 2) >> 12));
+    }
+  }
+  if (flush)
+  {
+    return make_strength(FLUSH, top_values[flush]);
+  }
+  high = rank_mask_straight_high(ones);
+  if (high)
+  {
+    return make_strength(STRAIGHT, straight_values(high));
+  }
+  if (threes)
+  {
+    unsigned t = highest_value(threes);
+    return make_strength(THREE_OF_A_KIND,
+        repeat_value(t, 3) | (top_values[ones & ~value_bit(t)] >> 12));
+  }
+  if (twos)
+  {
+    unsigned p1 = highest_value(twos);
+    unsigned rest = twos & ~value_bit(p1);
+    if (rest)
+    {
+      unsigned p2 = highest_value(rest);
+      unsigned kickers = ones & ~value_bit(p1) & ~value_bit(p2);
+      return make_strength(TWO_PAIR, repeat_value(p1, 2) |
+          (repeat_value(p2, 2) >> 8) | (top_values[kickers] >> 16));
+    }
+    return make_strength(PAIR,
+        repeat_value(p1, 2) | (top_values[ones & ~value_bit(p1)] >> 8));
+  }
+  return make_strength(NOTHING, top_values[ones]);
+}
+
+hand_strength_t cardset_strength(cardset_t set)
+/* Evaluates the best five-card poker hand among the cards in set (normally
+ * 5 to 7 cards).
+ */
+{
+  strength_state_t st;
+  strength_state_init(&st, set);
+  return strength_state_eval(&st);
+}
+
+hand_strength_t hand_strength(deck_t * hand)
+/* Strength of a hand of distinct cards. Placeholder cards are ignored. */
+{
+  return cardset_strength(cardset_from_deck(hand));
+}
+
+hand_strength_t best_strength(const hand_strength_t *strengths, size_t n_hands,
+                              size_t *n_best)
+/* Returns the best of n_hands strengths and sets *n_best to how many hands
+ * hold it, or returns 0 with *n_best 0 if there are no hands.
+ */
+{
+  hand_strength_t best = 0;
+  size_t count = 0;
+  for (size_t i = 0; i < n_hands; ++i)
+  {
+    if (strengths[i] > best || count == 0)
+    {
+      best = strengths[i];
+      count = 1;
+    }
+    else if (strengths[i] == best)
+    {
+      ++count;
+    }
+  }
+  *n_best = count;
+  return best;
+}
+
+size_t showdown_winners(const hand_strength_t *strengths, size_t n_hands, size_t *winners)
+/* Writes the indices of the hands that win the pot, in order, to winners
+ * (room for n_hands) and returns how many there are. More than one winner
+ * means the pot is split evenly between them.
+ */
+{
+  size_t n_best;
+  hand_strength_t best = best_strength(strengths, n_hands, &n_best);
+  size_t n = 0;
+  for (size_t i = 0; i < n_hands && n < n_best; ++i)
+  {
+    if (strengths[i] == best) winners[n++] = i;
+  }
+  return n;
+}
+
+size_t showdown(deck_t **hands, size_t n_hands, hand_strength_t *strengths, size_t *winners)
+/* Settles a showdown between n_hands hands of distinct cards, each
+ * evaluated once: writes their strengths to strengths and the winners to
+ * winners (both with room for n_hands) and returns the number of winners.
+ * Placeholder cards are ignored. Nothing is sorted or allocated.
+ */
+{
+  cardset_t sets[SHOWDOWN_BATCH];
+  for (size_t i = 0; i < n_hands; i += SHOWDOWN_BATCH)
+  {
+    size_t k = n_hands - i < SHOWDOWN_BATCH ? n_hands - i : SHOWDOWN_BATCH;
+    for (size_t j = 0; j < k; ++j)
+    {
+      sets[j] = cardset_from_deck(hands[i + j]);
+    }
+    cardset_strengths(sets, k, strengths + i);
+  }
+  return showdown_winners(strengths, n_hands, winners);
+}
+
+hand_ranking_t strength_ranking(hand_strength_t s)
+{
+  return NOTHING - (s >> STRENGTH_CATEGORY_SHIFT);
+}
+
+void print_strength(hand_strength_t s)
+{
+  printf("%s", ranking_to_string(strength_ranking(s)));
+  for (int i = 4; i >= 0; --i)
+  {
+    card_t c;
+    c.value = (s >> (4 * i)) & 0xf;
+    c.suit = SPADES;
+    printf(" %c", value_letter(c));
+  }
+}
+
+/* Batch evaluation. suit_mask_strengths and cardset_strengths run the
+ * kernels of the level init_strength_tables took from cpu_level. The
+ * scalar kernel evaluates one hand after another; the others are lanes.h
+ * compiled for SSE4.2, AVX2 and AVX-512 with vectors of 4, 8 and 16 lanes.
+ */
+static void suit_mask_strengths_scalar(const uint16_t *const suits[NUM_SUITS], size_t n,
+                                       hand_strength_t *out)
+{
+  for (size_t i = 0; i < n; ++i)
+  {
+    cardset_t set = CARDSET_EMPTY;
+    for (int s = 0; s < NUM_SUITS; ++s)
+    {
+      set |= (cardset_t) suits[s][i] << (13 * s);
+    }
+    out[i] = cardset_strength(set);
+  }
+}
+
+static void cardset_strengths_scalar(const cardset_t *sets, size_t n, hand_strength_t *out)
+{
+  for (size_t i = 0; i < n; ++i)
+  {
+    out[i] = cardset_strength(sets[i]);
+  }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#pragma GCC push_options
+#pragma GCC target("sse4.2,popcnt")
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpsabi"  /* no call between levels passes a vector */
+#define KERNEL_LANES 4
+#define KERNEL(name) name##_sse42
+#include "lanes.h"
+#undef KERNEL
+#undef KERNEL_LANES
+#pragma GCC diagnostic pop
+#pragma GCC pop_options
+
+#pragma GCC push_options
+#pragma GCC target("avx2,bmi,bmi2,popcnt")
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpsabi"
+#define KERNEL_LANES 8
+#define KERNEL(name) name##_avx2
+#include "lanes.h"
+#undef KERNEL
+#undef KERNEL_LANES
+#pragma GCC diagnostic pop
+#pragma GCC pop_options
+
+#pragma GCC push_options
+#pragma GCC target("avx512f,avx512bw,avx512dq,avx512vl,bmi,bmi2,popcnt")
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpsabi"
+#define KERNEL_LANES 16
+#define KERNEL(name) name##_avx512
+#include "lanes.h"
+#undef KERNEL
+#undef KERNEL_LANES
+#pragma GCC diagnostic pop
+#pragma GCC pop_options
+#endif
+
+struct strength_kernels_tag {
+  void (*suit_masks)(const uint16_t *const suits[NUM_SUITS], size_t n, hand_strength_t *out);
+  void (*cardsets)(const cardset_t *sets, size_t n, hand_strength_t *out);
+};
+typedef struct strength_kernels_tag strength_kernels_t;
+
+static const strength_kernels_t kernels[NUM_CPU_LEVELS] = {
+  { suit_mask_strengths_scalar, cardset_strengths_scalar },
+#if defined(__x86_64__) || defined(__i386__)
+  { suit_mask_strengths_lanes_sse42, cardset_strengths_lanes_sse42 },
+  { suit_mask_strengths_lanes_avx2, cardset_strengths_lanes_avx2 },
+  { suit_mask_strengths_lanes_avx512, cardset_strengths_lanes_avx512 },
+#endif
+};
+
+const char *strength_kernels_name(void)
+/* The level of the batch kernels in use, for reports. */
+{
+  need_tables();
+  return cpu_level_name(kernel_level);
+}
+
+void suit_mask_strengths(const uint16_t *const suits[NUM_SUITS], size_t n,
+                         hand_strength_t *out)
+/* Evaluates n hands laid out structure-of-arrays: suits[s][i] is the 13-bit
+ * rank mask of the cards of suit s in hand i. Writes the strength of hand i
+ * to out[i], as cardset_strength would give it.
+ */
+{
+  need_tables();
+  kernels[kernel_level].suit_masks(suits, n, out);
+}
+
+void cardset_strengths(const cardset_t *sets, size_t n, hand_strength_t *out)
+/* Evaluates n card sets in batches, as cardset_strength would each. */
+{
+  need_tables();
+  kernels[kernel_level].cardsets(sets, n, out);
+}
@@ -0,0 +1,64 @@
+#ifndef STRENGTH_H
+#define STRENGTH_H
+#include <stdint.h>
+#include "cards.h"
+#include "deck.h"
+#include "cardset.h"
+
+/* A hand strength packs a whole hand evaluation into one integer so that
+ * comparing two hands is a single integer comparison: a larger strength is
+ * a better hand and equal strengths tie. The ordering is exactly the one
+ * produced by compare_hands.
+ *
+ * Bits 20-23 hold the category (NOTHING - ranking, so a straight flush is 8)
+ * and bits 0-19 hold the values of the five cards compare_hands would break
+ * ties with, one per nibble, most significant first.
+ */
+typedef uint32_t hand_strength_t;
+
+#define STRENGTH_CATEGORY_SHIFT 20
+
+/* A partially evaluated hand: its cards plus the masks of the ranks held at
+ * least one, two, three and four times.
+ */
+struct strength_state_tag {
+  cardset_t cards;
+  unsigned ones;
+  unsigned twos;
+  unsigned threes;
+  unsigned fours;
+};
+typedef struct strength_state_tag strength_state_t;
+
+#define RANK_MASK_WHEEL 0x100fu
+
+static inline unsigned rank_mask_straight_high(unsigned ranks)
+/* Value of the highest card of the best straight in a 13-bit rank mask: 5
+ * for the A-2-3-4-5 wheel, or 0 if it holds no straight. Passing the rank
+ * mask of one suit finds straight flushes. It uses no table, so
+ * evaluate_hand needs no set-up.
+ */
+{
+  ranks &= RANK_MASK_ALL;
+  /* Bit i of runs is set when ranks i to i + 4 are all held. */
+  unsigned runs = ranks & (ranks >> 1) & (ranks >> 2) & (ranks >> 3) & (ranks >> 4);
+  if (runs != 0) return 31 - __builtin_clz(runs) + 2 + 4;
+  return (ranks & RANK_MASK_WHEEL) == RANK_MASK_WHEEL ? 5 : 0;
+}
+
+void init_strength_tables(void);
+void strength_state_init(strength_state_t *st, cardset_t set);
+hand_strength_t strength_state_eval(const strength_state_t *st);
+hand_strength_t cardset_strength(cardset_t set);
+void suit_mask_strengths(const uint16_t *const suits[NUM_SUITS], size_t n,
+                         hand_strength_t *out);
+void cardset_strengths(const cardset_t *sets, size_t n, hand_strength_t *out);
+const char *strength_kernels_name(void);
+hand_strength_t hand_strength(deck_t * hand);
+hand_strength_t best_strength(const hand_strength_t *strengths, size_t n_hands,
+                              size_t *n_best);
+size_t showdown_winners(const hand_strength_t *strengths, size_t n_hands, size_t *winners);
+size_t showdown(deck_t **hands, size_t n_hands, hand_strength_t *strengths, size_t *winners);
+hand_ranking_t strength_ranking(hand_strength_t s);
+void print_strength(hand_strength_t s);
+#endif
@@ -0,0 +1,47 @@
+#include "suitperm.h"
+
+const unsigned char suit_perms[N_SUIT_PERMS][NUM_SUITS] = {
+  {0, 1, 2, 3}, {0, 1, 3, 2}, {0, 2, 1, 3}, {0, 2, 3, 1}, {0, 3, 1, 2}, {0, 3, 2, 1},
+  {1, 0, 2, 3}, {1, 0, 3, 2}, {1, 2, 0, 3}, {1, 2, 3, 0}, {1, 3, 0, 2}, {1, 3, 2, 0},
+  {2, 0, 1, 3}, {2, 0, 3, 1}, {2, 1, 0, 3}, {2, 1, 3, 0}, {2, 3, 0, 1}, {2, 3, 1, 0},
+  {3, 0, 1, 2}, {3, 0, 2, 1}, {3, 1, 0, 2}, {3, 1, 2, 0}, {3, 2, 0, 1}, {3, 2, 1, 0}
+};
+
+suit_group_t suit_stabiliser(const cardset_t *sets, size_t n_sets, suit_group_t group)
+/* Returns the permutations of group that map every one of the sets onto
+ * itself.
+ */
+{
+  suit_group_t stab = 0;
+  for (unsigned p = 0; p < N_SUIT_PERMS; ++p)
+  {
+    if (!(group & ((suit_group_t) 1 << p))) continue;
+    size_t i = 0;
+    while (i < n_sets && permute_suits(sets[i], p) == sets[i])
+    {
+      ++i;
+    }
+    if (i == n_sets) stab |= (suit_group_t) 1 << p;
+  }
+  return stab;
+}
+
+int suit_orbit_leader(cardset_t set, suit_group_t group, suit_group_t *stab, unsigned *orbit)
+/* Returns 1 if set is the smallest of its images under the permutations
+ * of group (which must be a group), and 0 otherwise. For a leader, fills
+ * in the permutations of group that fix set and the number of distinct
+ * images of set.
+ */
+{
+  suit_group_t fixed = 0;
+  for (unsigned p = 0; p < N_SUIT_PERMS; ++p)
+  {
+    if (!(group & ((suit_group_t) 1 << p))) continue;
+    cardset_t image = permute_suits(set, p);
+    if (image < set) return 0;
+    if (image == set) fixed |= (suit_group_t) 1 << p;
+  }
+  *stab = fixed;
+  *orbit = __builtin_popcount(group) / __builtin_popcount(fixed);
+  return 1;
+}
@@ -0,0 +1,39 @@
+#ifndef SUITPERM_H
+#define SUITPERM_H
+#include <stdint.h>
+#include "cards.h"
+#include "cardset.h"
+
+/* Relabelling the suits of every card in a scenario does not change any
+ * hand's strength, so scenarios (and outcomes) that differ only by a
+ * permutation of the suits are equivalent. suit_perms lists the 24
+ * permutations, the identity first: suit s becomes suit_perms[i][s]. A
+ * suit_group_t is a set of them, bit i standing for suit_perms[i].
+ */
+#define N_SUIT_PERMS 24
+typedef uint32_t suit_group_t;
+
+#define SUIT_GROUP_IDENTITY ((suit_group_t) 1)
+#define SUIT_GROUP_ALL ((((suit_group_t) 1) << N_SUIT_PERMS) - 1)
+
+extern const unsigned char suit_perms[N_SUIT_PERMS][NUM_SUITS];
+
+static inline cardset_t cardset_map_suits(cardset_t set, const unsigned char to[NUM_SUITS])
+/* Moves the cards of every suit s to suit to[s], a permutation. */
+{
+  cardset_t out = CARDSET_EMPTY;
+  for (suit_t s = SPADES; s < NUM_SUITS; ++s)
+  {
+    out |= (cardset_t) cardset_suit(set, s) << (13 * to[s]);
+  }
+  return out;
+}
+
+static inline cardset_t permute_suits(cardset_t set, unsigned perm)
+{
+  return cardset_map_suits(set, suit_perms[perm]);
+}
+
+suit_group_t suit_stabiliser(const cardset_t *sets, size_t n_sets, suit_group_t group);
+int suit_orbit_leader(cardset_t set, suit_group_t group, suit_group_t *stab, unsigned *orbit);
+#endif
@@ -0,0 +1,209 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cardset.h"
+#include "deck.h"
+#include "enumerate.h"
+#include "future.h"
+#include "input.h"
+#include "scenario.h"
+#include "sim.h"
+#include "strength.h"
+
+/*
+   Checks run_enumeration against a brute force count that deals every
+   ordered assignment of cards to the unknown cards (and every combination
+   of every range, weighted by its weight) without any of the enumeration's
+   shortcuts: grouping interchangeable unknown cards into classes, suit
+   symmetry with its orbit weights, and dividing range weights by their
+   greatest common divisor. Those change how many times an outcome is
+   counted but not the proportions, so the check is that every count is
+   the same fraction of the total. The enumeration must also give the same
+   counts on one thread and on several.
+*/
+
+#define N_THREADS 4
+
+static int failures = 0;
+
+static void check(int ok, const char *what)
+{
+    printf("%-60s %s\n", what, ok ? "ok" : "FAILED");
+    if (!ok)
+    {
+        ++failures;
+    }
+}
+
+struct brute_tag {
+    scenario_t *sc;
+    cardset_t holes[DECK_SIZE];   /* dealt from hand h's range */
+    cardset_t dealt[DECK_SIZE];   /* the card dealt to ?s */
+    hand_strength_t strengths[DECK_SIZE];
+    sim_result_t *res;
+};
+typedef struct brute_tag brute_t;
+
+static void brute_leaf(brute_t *b, unsigned long long weight)
+{
+    scenario_t *sc = b->sc;
+    for (size_t h = 0; h < sc->n_hands; ++h)
+    {
+        cardset_t set = sc->known[h] | b->holes[h];
+        for (size_t s = 0; s < sc->n_slots; ++s)
+        {
+            if (scenario_uses(sc, h, s)) set |= b->dealt[s];
+        }
+        b->strengths[h] = cardset_strength(set);
+    }
+    record_showdown(b->strengths, sc->n_hands, weight, b->res);
+}
+
+static void brute_slots(brute_t *b, size_t s, cardset_t used, unsigned long long weight)
+{
+    scenario_t *sc = b->sc;
+    while (s < sc->n_slots && !slot_is_used(sc, s))
+    {
+        ++s;
+    }
+    if (s == sc->n_slots)
+    {
+        brute_leaf(b, weight);
+        return;
+    }
+    for (unsigned c = 0; c < DECK_SIZE; ++c)
+    {
+        cardset_t card = cardset_from_num(c);
+        if (used & card) continue;
+        b->dealt[s] = card;
+        brute_slots(b, s + 1, used | card, weight);
+    }
+}
+
+static void brute_ranges(brute_t *b, size_t h, cardset_t used, unsigned long long weight)
+{
+    scenario_t *sc = b->sc;
+    if (h == sc->n_hands)
+    {
+        brute_slots(b, 0, used, weight);
+        return;
+    }
+    const range_t *range = sc->ranges != NULL ? sc->ranges[h] : NULL;
+    if (range == NULL)
+    {
+        b->holes[h] = CARDSET_EMPTY;
+        brute_ranges(b, h + 1, used, weight);
+        return;
+    }
+    for (size_t i = 0; i < range->n_combos; ++i)
+    {
+        if (range->combos[i] & used) continue;
+        b->holes[h] = range->combos[i];
+        brute_ranges(b, h + 1, used | range->combos[i], weight * range->weights[i]);
+    }
+}
+
+static int same_share(unsigned long long x, unsigned long long total_x,
+                      unsigned long long y, unsigned long long total_y)
+/* Whether x / total_x == y / total_y; the counts here are small enough
+ * that the products fit, and an overflow counts as a difference.
+ */
+{
+    unsigned long long lhs, rhs;
+    if (__builtin_mul_overflow(x, total_y, &lhs) || __builtin_mul_overflow(y, total_x, &rhs))
+    {
+        return 0;
+    }
+    return lhs == rhs;
+}
+
+static int same_fractions(const sim_result_t *a, const sim_result_t *b)
+/* Whether every count of a is the same fraction of a's total as in b. */
+{
+    size_t n = a->n_hands;
+    if (a->n_trials == 0 || b->n_trials == 0)
+    {
+        return 0;
+    }
+    for (size_t h = 0; h < n; ++h)
+    {
+        if (!same_share(a->wins[h], a->n_trials, b->wins[h], b->n_trials) ||
+            !same_share(a->ties[h], a->n_trials, b->ties[h], b->n_trials))
+        {
+            return 0;
+        }
+        for (size_t k = 2; k <= n; ++k)
+        {
+            size_t i = split_index(n, h, k);
+            if (!same_share(a->split_ties[i], a->n_trials, b->split_ties[i], b->n_trials))
+            {
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+static int same_counts(const sim_result_t *a, const sim_result_t *b)
+{
+    return a->n_trials == b->n_trials && same_fractions(a, b);
+}
+
+static void check_scenario(const char *name, const char *text)
+{
+    char what[80];
+    FILE *f = fmemopen((void *) text, strlen(text), "r");
+    future_cards_t *fc = init_future_cards();
+    size_t n_hands = 0;
+    deck_t **hands = f != NULL && fc != NULL ? read_input(f, &n_hands, fc) : NULL;
+    scenario_t *sc = hands != NULL ? compile_scenario(hands, n_hands, fc) : NULL;
+    sim_result_t *one = sc != NULL ? run_enumeration(sc, 1) : NULL;
+    sim_result_t *many = sc != NULL ? run_enumeration(sc, N_THREADS) : NULL;
+    brute_t b;
+    b.sc = sc;
+    b.res = sc != NULL ? init_sim_result(n_hands) : NULL;
+    if (one == NULL || many == NULL || b.res == NULL)
+    {
+        snprintf(what, sizeof(what), "%s: enumerates", name);
+        check(0, what);
+    }
+    else
+    {
+        brute_ranges(&b, 0, sc->dead, 1);
+        snprintf(what, sizeof(what), "%s: matches the brute force count", name);
+        check(one->exact && same_fractions(one, b.res), what);
+        snprintf(what, sizeof(what), "%s: same counts on 1 and %d threads", name, N_THREADS);
+        check(same_counts(one, many), what);
+    }
+    free_sim_result(b.res);
+    free_sim_result(many);
+    free_sim_result(one);
+    free_scenario(sc);
+    free_decks(hands, n_hands);
+    free_future_cards(fc);
+    if (f != NULL)
+    {
+        fclose(f);
+    }
+}
+
+int main(void)
+{
+    init_strength_tables();
+    check_scenario("one private unknown",
+                   "Ah ?3 ?0 ?1 ?2\n"
+                   "7c 7d ?0 ?1 ?2\n");
+    check_scenario("three-way splits",
+                   "2c 3d As ?0 Qs Js ?1\n"
+                   "4c 5d As ?0 Qs Js ?1\n"
+                   "6c 7d As ?0 Qs Js ?1\n");
+    check_scenario("weighted range",
+                   "[AhKh, QQ:0.5, JTs:0.3] Js 0s 2c ?0 ?1\n"
+                   "9c 9d Js 0s 2c ?0 ?1\n");
+    check_scenario("two ranges",
+                   "[AA, KK:0.5] 9s 8s 2c 3d ?0\n"
+                   "[AKs, AA:0.2] 9s 8s 2c 3d ?0\n"
+                   "?1 ?2 9s 8s 2c 3d ?0\n");
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,366 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "cards.h"
+#include "cardset.h"
+#include "deck.h"
+#include "eval.h"
+#include "rng.h"
+#include "sim.h"
+#include "strength.h"
+
+/*
+   Checks the hand evaluators against each other over a seeded random
+   corpus of 5 to 9 card hands, with extra wheels, steel wheels, hands
+   holding two trips and straight- or flush-heavy hands: the strength order
+   of cardset_strength must be the order of compare_hands, and the
+   specialised 5 to 7 card paths of evaluate_hand must pick the same cards
+   as evaluate_hand_generic, whose five cards must make the hand's best
+   hand. A few 8 and 9 card hands with wheel straight flushes are checked
+   by name, as are showdowns won outright and split two and three ways, which
+   record_showdown must count as showdown settles them.
+*/
+
+#define CORPUS_SEED 20241017
+#define N_HANDS 200000
+
+static int failures = 0;
+
+static void check(int ok, const char *what)
+{
+    printf("%-60s %s\n", what, ok ? "ok" : "FAILED");
+    if (!ok)
+    {
+        ++failures;
+    }
+}
+
+static void add_card_once(deck_t *hand, cardset_t *used, unsigned c)
+{
+    if (*used & cardset_from_num(c))
+    {
+        return;
+    }
+    *used |= cardset_from_num(c);
+    add_card_to(hand, card_from_num(c));
+}
+
+static void add_rank(deck_t *hand, cardset_t *used, rng_t *rng, unsigned rank, unsigned n)
+/* Adds n cards of rank (0 for a deuce), of random suits. */
+{
+    while (n > 0)
+    {
+        unsigned c = rng_bounded(rng, NUM_SUITS) * 13 + rank;
+        if (*used & cardset_from_num(c))
+        {
+            continue;
+        }
+        add_card_once(hand, used, c);
+        --n;
+    }
+}
+
+static deck_t *corpus_hand(rng_t *rng, size_t i)
+/* Hand i of the corpus: half the hands start with a wheel, a steel wheel,
+ * two trips or a run of five or more ranks, or have most of their cards in
+ * one suit, and the rest of every hand is random.
+ */
+{
+    deck_t *hand = initialize_deck();
+    cardset_t used = CARDSET_EMPTY;
+    size_t n_cards = 5 + rng_bounded(rng, 5);
+    switch (i % 8)
+    {
+        case 1:
+            /* A-2-3-4-5, suits at random */
+            add_rank(hand, &used, rng, 12, 1);
+            for (unsigned r = 0; r < 4; ++r)
+            {
+                add_rank(hand, &used, rng, r, 1);
+            }
+            break;
+        case 3:
+        {
+            unsigned suit = rng_bounded(rng, NUM_SUITS);
+            add_card_once(hand, &used, suit * 13 + 12);
+            for (unsigned r = 0; r < 4; ++r)
+            {
+                add_card_once(hand, &used, suit * 13 + r);
+            }
+            break;
+        }
+        case 5:
+        {
+            unsigned r1 = rng_bounded(rng, 13);
+            unsigned r2 = (r1 + 1 + rng_bounded(rng, 12)) % 13;
+            add_rank(hand, &used, rng, r1, 3);
+            add_rank(hand, &used, rng, r2, 3);
+            if (n_cards < 6)
+            {
+                n_cards = 6;
+            }
+            break;
+        }
+        case 7:
+            if (rng_bounded(rng, 2) == 0)
+            {
+                unsigned low = rng_bounded(rng, 9);
+                unsigned len = 5 + rng_bounded(rng, 3);
+                for (unsigned r = low; r < low + len && r < 13; ++r)
+                {
+                    add_rank(hand, &used, rng, r, 1);
+                }
+            }
+            else
+            {
+                unsigned suit = rng_bounded(rng, NUM_SUITS);
+                while (hand->n_cards + 1 < n_cards)
+                {
+                    add_card_once(hand, &used, suit * 13 + rng_bounded(rng, 13));
+                }
+            }
+            break;
+    }
+    while (hand->n_cards < n_cards)
+    {
+        add_card_once(hand, &used, rng_bounded(rng, DECK_SIZE));
+    }
+    sort_hand(hand);
+    return hand;
+}
+
+static int sign(long long x)
+{
+    return (x > 0) - (x < 0);
+}
+
+static void check_strength_order(deck_t **hands)
+{
+    size_t n_wrong_ranking = 0;
+    size_t n_wrong_order = 0;
+    for (size_t i = 0; i < N_HANDS; ++i)
+    {
+        hand_strength_t s = hand_strength(hands[i]);
+        if (strength_ranking(s) != evaluate_hand(hands[i]).ranking)
+        {
+            ++n_wrong_ranking;
+        }
+        deck_t *other = hands[(i + 1) % N_HANDS];
+        long long diff = (long long) s - (long long) hand_strength(other);
+        if (sign(compare_hands(hands[i], other)) != sign(diff))
+        {
+            ++n_wrong_order;
+        }
+    }
+    check(n_wrong_ranking == 0, "cardset_strength ranks hands as evaluate_hand does");
+    check(n_wrong_order == 0, "cardset_strength orders hands as compare_hands does");
+}
+
+static int same_eval(hand_eval_t a, hand_eval_t b)
+/* Same ranking and the same card pointers in the same order. */
+{
+    if (a.ranking != b.ranking)
+    {
+        return 0;
+    }
+    for (int i = 0; i < 5; ++i)
+    {
+        if (a.cards[i] != b.cards[i])
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void check_fixed_paths(deck_t **hands)
+{
+    size_t n_checked = 0;
+    size_t n_wrong = 0;
+    for (size_t i = 0; i < N_HANDS; ++i)
+    {
+        if (hands[i]->n_cards > 7)
+        {
+            continue;
+        }
+        ++n_checked;
+        if (!same_eval(evaluate_hand(hands[i]), evaluate_hand_generic(hands[i])))
+        {
+            ++n_wrong;
+        }
+    }
+    check(n_checked > 0 && n_wrong == 0,
+          "5 to 7 card paths match evaluate_hand_generic card for card");
+}
+
+static cardset_t eval_cards(hand_eval_t eval)
+{
+    cardset_t set = CARDSET_EMPTY;
+    for (int i = 0; i < 5; ++i)
+    {
+        set |= cardset_from_card(*eval.cards[i]);
+    }
+    return set;
+}
+
+static void check_generic_path(deck_t **hands)
+{
+    size_t n_long = 0;
+    size_t n_wrong = 0;
+    for (size_t i = 0; i < N_HANDS; ++i)
+    {
+        hand_eval_t eval = evaluate_hand_generic(hands[i]);
+        hand_strength_t best = hand_strength(hands[i]);
+        if (strength_ranking(best) != eval.ranking ||
+            cardset_strength(eval_cards(eval)) != best)
+        {
+            ++n_wrong;
+        }
+        n_long += hands[i]->n_cards >= 8;
+    }
+    check(n_long > 0 && n_wrong == 0, "evaluate_hand_generic picks the best five cards");
+}
+
+static deck_t *hand_of(const char *text)
+/* A sorted hand from pairs of value and suit letters. */
+{
+    deck_t *hand = initialize_deck();
+    for (const char *p = text; p[0] != '\0' && p[1] != '\0'; p += p[2] != '\0' ? 3 : 2)
+    {
+        add_card_to(hand, card_from_letters(p[0], p[1]));
+    }
+    sort_hand(hand);
+    return hand;
+}
+
+static void check_named_hands(void)
+{
+    static const struct {
+        const char *cards;
+        hand_ranking_t ranking;
+        const char *best;   /* the five cards picked, best first */
+    } cases[] = {
+        { "As 2s 3s 4s 5s 9d 9h 9c", STRAIGHT_FLUSH, "5s 4s 3s 2s As" },
+        { "As 2s 3s 4s 5s 6d 7c 8h 9h", STRAIGHT_FLUSH, "5s 4s 3s 2s As" },
+        { "As 2s 3s 4s 5s 6s Kd Kh Kc", STRAIGHT_FLUSH, "6s 5s 4s 3s 2s" },
+        { "Ah 2h 3h 4h 5h Ad Ac As", STRAIGHT_FLUSH, "5h 4h 3h 2h Ah" },
+        { "Ad 2h 3h 4h 5h 6c 7c 8d 9d", STRAIGHT, "9d 8d 7c 6c 5h" },
+        { "Ad 2h 3c 4h 5s Kc Qc Jd 9d", STRAIGHT, "5s 4h 3c 2h Ad" },
+        { "Ah 2h 3h 4h 6h Kh 5d 5c", FLUSH, "Ah Kh 6h 4h 3h" },
+    };
+    size_t n_wrong = 0;
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); ++i)
+    {
+        deck_t *hand = hand_of(cases[i].cards);
+        deck_t *best = hand_of(cases[i].best);
+        hand_eval_t eval = evaluate_hand(hand);
+        if (eval.ranking != cases[i].ranking || eval_cards(eval) != cardset_from_deck(best) ||
+            !same_eval(eval, evaluate_hand_generic(hand)))
+        {
+            printf("  wrong answer for %s\n", cases[i].cards);
+            ++n_wrong;
+        }
+        free_deck(hand);
+        free_deck(best);
+    }
+    check(n_wrong == 0, "8 and 9 card hands with wheels give the named hands");
+}
+
+static int counts_winners(const sim_result_t *res, const size_t *winners, size_t n_winners)
+/* Whether res counts one trial won by, or split between, the winners. */
+{
+    size_t n = res->n_hands;
+    size_t w = 0;
+    for (size_t h = 0; h < n; ++h)
+    {
+        int won = w < n_winners && winners[w] == h;
+        w += won;
+        if (res->wins[h] != (won && n_winners == 1) || res->ties[h] != (won && n_winners > 1))
+        {
+            return 0;
+        }
+        for (size_t k = 2; k <= n; ++k)
+        {
+            if (res->split_ties[split_index(n, h, k)] != (won && k == n_winners))
+            {
+                return 0;
+            }
+        }
+    }
+    return res->n_trials == 1;
+}
+
+static void check_showdowns(void)
+{
+    static const struct {
+        const char *hands[4];   /* hole cards, with the board added */
+        const char *board;
+        size_t n_winners;
+        size_t winners[4];
+    } cases[] = {
+        { { "Ac Ad", "Kc Kd", NULL }, "2c 3d 8h 9s Jc", 1, { 0 } },
+        { { "0c 2d", "0d 3c", "Ac Ad", NULL }, "As Ks Qd Jc 9h", 2, { 0, 1 } },
+        { { "Qh Qd", "Ah 3c", "Ad 4c", "As 5c" }, "2c 2d 2h 2s Kc", 3, { 1, 2, 3 } },
+        { { "2c 3c", "4d 5d", "6h 7h", NULL }, "As Ks Qs Js 0s", 3, { 0, 1, 2 } },
+    };
+    size_t n_wrong = 0;
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); ++i)
+    {
+        deck_t *hands[4];
+        size_t n_hands = 0;
+        while (n_hands < 4 && cases[i].hands[n_hands] != NULL)
+        {
+            char text[32];
+            snprintf(text, sizeof(text), "%s %s", cases[i].hands[n_hands], cases[i].board);
+            hands[n_hands] = hand_of(text);
+            ++n_hands;
+        }
+        hand_strength_t strengths[4];
+        size_t winners[4];
+        size_t n_winners = showdown(hands, n_hands, strengths, winners);
+        int ok = n_winners == cases[i].n_winners;
+        for (size_t w = 0; ok && w < n_winners; ++w)
+        {
+            ok = winners[w] == cases[i].winners[w];
+        }
+        sim_result_t *res = init_sim_result(n_hands);
+        if (res != NULL)
+        {
+            record_showdown(strengths, n_hands, 1, res);
+        }
+        if (!ok || res == NULL || !counts_winners(res, winners, n_winners))
+        {
+            printf("  wrong showdown on %s\n", cases[i].board);
+            ++n_wrong;
+        }
+        free_sim_result(res);
+        for (size_t h = 0; h < n_hands; ++h)
+        {
+            free_deck(hands[h]);
+        }
+    }
+    check(n_wrong == 0, "showdowns are won outright or split as they should be");
+}
+
+int main(void)
+{
+    rng_t rng;
+    rng_seed(&rng, CORPUS_SEED);
+    deck_t **hands = malloc(sizeof(*hands) * N_HANDS);
+    if (hands == NULL)
+    {
+        return EXIT_FAILURE;
+    }
+    for (size_t i = 0; i < N_HANDS; ++i)
+    {
+        hands[i] = corpus_hand(&rng, i);
+    }
+
+    check_strength_order(hands);
+    check_fixed_paths(hands);
+    check_generic_path(hands);
+    check_named_hands();
+    check_showdowns();
+
+    free_decks(hands, N_HANDS);
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
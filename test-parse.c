@@ -0,0 +1,285 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "deck.h"
+#include "future.h"
+#include "input.h"
+#include "range.h"
+
+/*
+   Checks the input tokenizer through read_input: the hands it reads from
+   CRLF lines, an unterminated last line and a line longer than the read
+   buffer, the name:line:column of its errors, the rejection of bad
+   placeholders, and that a regular file, which is parsed in a mapping, reads
+   as the same text does through the buffered path. Ranges printed by
+   fprint_range must read back as the same range.
+*/
+
+#define LONG_LINE (3 << 16)   /* longer than read_buffered's first chunk */
+#define N_LINES 6000
+
+static int failures = 0;
+static char path[] = "/tmp/test-parse-XXXXXX";
+
+static void check(int ok, const char *what)
+{
+    printf("%-60s %s\n", what, ok ? "ok" : "FAILED");
+    if (!ok)
+    {
+        ++failures;
+    }
+}
+
+static char *describe(deck_t **hands, size_t n_hands, future_cards_t *fc)
+/* The hands read, one per line as fprint_future_hand prints them, in a
+ * malloced string.
+ */
+{
+    char *text = NULL;
+    size_t size = 0;
+    FILE *f = open_memstream(&text, &size);
+    if (f == NULL)
+    {
+        return NULL;
+    }
+    for (size_t h = 0; h < n_hands; ++h)
+    {
+        fprint_future_hand(f, hands[h], fc);
+        fputc('\n', f);
+    }
+    fclose(f);
+    return text;
+}
+
+static char *parse(const char *text, int mapped, char *errors, size_t errors_size)
+/*
+   Reads text through read_input, from a regular file if mapped and from
+   memory otherwise, and returns what describe gives for the hands, or NULL
+   if the read failed. What read_input printed to stderr is left in errors.
+*/
+{
+    FILE *f;
+    if (mapped)
+    {
+        FILE *out = fopen(path, "w");
+        if (out == NULL)
+        {
+            return NULL;
+        }
+        fputs(text, out);
+        fclose(out);
+        f = fopen(path, "r");
+    }
+    else
+    {
+        f = fmemopen((void *) text, strlen(text), "r");
+    }
+    FILE *err = tmpfile();
+    future_cards_t *fc = init_future_cards();
+    if (f == NULL || err == NULL || fc == NULL)
+    {
+        free_future_cards(fc);
+        if (err != NULL) fclose(err);
+        if (f != NULL) fclose(f);
+        return NULL;
+    }
+
+    fflush(stderr);
+    int saved = dup(STDERR_FILENO);
+    dup2(fileno(err), STDERR_FILENO);
+    size_t n_hands = 0;
+    deck_t **hands = read_input(f, &n_hands, fc);
+    fflush(stderr);
+    dup2(saved, STDERR_FILENO);
+    close(saved);
+
+    rewind(err);
+    size_t n = fread(errors, 1, errors_size - 1, err);
+    errors[n] = '\0';
+    char *got = hands != NULL ? describe(hands, n_hands, fc) : NULL;
+    free_decks(hands, n_hands);
+    free_future_cards(fc);
+    fclose(err);
+    fclose(f);
+    return got;
+}
+
+static int reads_as(const char *text, const char *expected)
+/* Whether text reads as the hands in expected through both paths. */
+{
+    char errors[256];
+    int ok = 1;
+    for (int mapped = 0; mapped <= 1; ++mapped)
+    {
+        char *got = parse(text, mapped, errors, sizeof(errors));
+        ok = ok && got != NULL && strcmp(got, expected) == 0 && errors[0] == '\0';
+        free(got);
+    }
+    return ok;
+}
+
+static int fails_with(const char *text, const char *error)
+/* Whether reading text fails with the error message error on both paths. */
+{
+    char errors[256];
+    int ok = 1;
+    for (int mapped = 0; mapped <= 1; ++mapped)
+    {
+        char *got = parse(text, mapped, errors, sizeof(errors));
+        ok = ok && got == NULL && strcmp(errors, error) == 0;
+        free(got);
+    }
+    return ok;
+}
+
+static void check_lines(void)
+{
+    const char *expected = "As Ks ?0 ?1 ?2\n7c 7d ?0 ?1 ?2\n";
+    check(reads_as("As Ks ?0 ?1 ?2\n\n7c 7d ?0 ?1 ?2\n", expected),
+          "reads hands one per line, skipping blank lines");
+    check(reads_as("As Ks ?0 ?1 ?2\r\n\r\n7c 7d ?0 ?1 ?2\r\n", expected), "reads CRLF lines");
+    check(reads_as("As Ks ?0 ?1 ?2\n7c 7d ?0 ?1 ?2", expected),
+          "reads an unterminated last line");
+    check(reads_as("  [AKs]\t?0 ?1 ?2\n7c 7d ?0 ?1 ?2\n", "[AKs] ?0 ?1 ?2\n7c 7d ?0 ?1 ?2\n"),
+          "reads a range as two hole cards");
+}
+
+static void check_long_line(void)
+{
+    char *text = malloc(LONG_LINE + 64);
+    if (text == NULL)
+    {
+        check(0, "reads a line longer than the read buffer");
+        return;
+    }
+    strcpy(text, "7c");
+    memset(text + 2, ' ', LONG_LINE);
+    strcpy(text + 2 + LONG_LINE, "7d ?0 ?1 ?2\nAs Ks ?0 ?1 ?2\n");
+    check(reads_as(text, "7c 7d ?0 ?1 ?2\nAs Ks ?0 ?1 ?2\n"),
+          "reads a line longer than the read buffer");
+    free(text);
+}
+
+static void check_errors(void)
+{
+    check(fails_with("As Ks ?0 ?1 ?2\n7c 7d ?0 Xx ?2\n", "input:2:10: Invalid card 'Xx'.\n"),
+          "reports a bad card with its line and column");
+    check(fails_with("As Ks ?0 ?1 ?2\r\n\r\n7c 7d\r\n", "input:3: Not enough cards in hand.\n"),
+          "reports a short hand with its line");
+    check(fails_with("As Ks ?0 ?1 ?52\n", "input:1:13: Invalid card index '?52'.\n"),
+          "rejects ?52");
+    check(fails_with("As Ks ?0 ? ?2\n", "input:1:10: Invalid card index '?'.\n"),
+          "rejects a bare ?");
+    check(fails_with("As Ks ?0 ?1 ?2\xa0\n", "input:1:13: Invalid card index '?2\xa0'.\n"),
+          "does not take a non-ASCII byte for a blank");
+}
+
+static void check_paths_agree(void)
+/* Many lines of varied lengths, so that lines straddle the buffered reads. */
+{
+    static const char *lines[] = {
+        "As Ks ?0 ?1 ?2\n", "7c 7d ?0 ?1 ?2 ?3 ?4\r\n", "\n", "2h 3h 4h 5h 6h 7h 8h 9h 0h\n",
+        "   Qd\tJd 0d 9d 8d   \n", "[QQ+, AKs:0.5] ?0 ?1 ?2 ?3 ?4\n",
+    };
+    size_t n_kinds = sizeof(lines) / sizeof(lines[0]);
+    char *text = NULL;
+    size_t size = 0;
+    FILE *f = open_memstream(&text, &size);
+    if (f == NULL)
+    {
+        check(0, "the mapped and buffered paths read the same hands");
+        return;
+    }
+    for (size_t i = 0; i < N_LINES; ++i)
+    {
+        fputs(lines[i % n_kinds], f);
+    }
+    fputs("Ah Kh Qh Jh 0h", f);
+    fclose(f);
+    char errors[256];
+    char *buffered = parse(text, 0, errors, sizeof(errors));
+    char *mapped = parse(text, 1, errors, sizeof(errors));
+    check(buffered != NULL && mapped != NULL && strcmp(buffered, mapped) == 0,
+          "the mapped and buffered paths read the same hands");
+    free(mapped);
+    free(buffered);
+    free(text);
+}
+
+static int same_range(const range_t *a, const range_t *b)
+/* The same combinations with the same weights, in any order. */
+{
+    if (a->n_combos != b->n_combos)
+    {
+        return 0;
+    }
+    for (size_t i = 0; i < a->n_combos; ++i)
+    {
+        size_t j = 0;
+        while (j < b->n_combos && b->combos[j] != a->combos[i])
+        {
+            ++j;
+        }
+        if (j == b->n_combos || b->weights[j] != a->weights[i])
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void check_printed_ranges(void)
+{
+    static const char *ranges[] = {
+        "QQ+, AKs, AQo:0.5, 76s:0.3, AhJh", "22-55:0.25, A2s+", "AK, KsKh, KdKc:0.5",
+        "9d8d:0.25, 8s8h, T9o, J0s:0.7",
+    };
+    size_t n_wrong = 0;
+    for (size_t i = 0; i < sizeof(ranges) / sizeof(ranges[0]); ++i)
+    {
+        range_t *range = parse_range(ranges[i], strlen(ranges[i]), NULL);
+        char *text = NULL;
+        size_t size = 0;
+        FILE *f = open_memstream(&text, &size);
+        if (range != NULL && f != NULL)
+        {
+            fprint_range(f, range);
+        }
+        if (f != NULL)
+        {
+            fclose(f);
+        }
+        range_t *again = text != NULL && size > 2 ? parse_range(text + 1, size - 2, NULL) : NULL;
+        if (range == NULL || again == NULL || text[0] != '[' || !same_range(range, again))
+        {
+            printf("  %s printed as %s\n", ranges[i], text != NULL ? text : "nothing");
+            ++n_wrong;
+        }
+        free_range(again);
+        free_range(range);
+        free(text);
+    }
+    check(n_wrong == 0, "ranges print as text that reads back as the same range");
+}
+
+int main(void)
+{
+    int fd = mkstemp(path);
+    if (fd < 0)
+    {
+        perror("mkstemp");
+        return EXIT_FAILURE;
+    }
+    close(fd);
+
+    check_lines();
+    check_long_line();
+    check_errors();
+    check_paths_agree();
+    check_printed_ranges();
+
+    unlink(path);
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
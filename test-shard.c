@@ -0,0 +1,154 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "future.h"
+#include "input.h"
+#include "scenario.h"
+#include "shard.h"
+#include "sim.h"
+
+/*
+   Checks that partial results written by the shards of one run merge into
+   the counts of the unsharded run, that the batches of stratified shards
+   survive the files and the merge, so that the merged run reports its
+   variance reduction, and that poker-merge's merge refuses shards of runs
+   that differ in their trial count or sampling methods, which would
+   otherwise be added up as if they covered disjoint trials.
+*/
+
+#define SEED 20241017
+#define N_SHARDS 3
+
+static int failures = 0;
+
+static void check(int ok, const char *what)
+{
+    printf("%-60s %s\n", what, ok ? "ok" : "FAILED");
+    if (!ok)
+    {
+        ++failures;
+    }
+}
+
+static scenario_t *read_scenario(const char *text, future_cards_t *fc)
+/* Compiles the hands in text, read as an input file is. */
+{
+    FILE *f = fmemopen((void *) text, strlen(text), "r");
+    if (f == NULL)
+    {
+        return NULL;
+    }
+    size_t n_hands = 0;
+    deck_t **hands = read_input(f, &n_hands, fc);
+    fclose(f);
+    scenario_t *sc = hands != NULL ? compile_scenario(hands, n_hands, fc) : NULL;
+    free_decks(hands, n_hands);
+    return sc;
+}
+
+static partial_result_t *run_shard(scenario_t *sc, unsigned long long n_trials,
+                                   unsigned sampling, unsigned shard, const char *path)
+/* Runs one shard, writes it to path and returns what reading it back gives. */
+{
+    sim_result_t *res = simulate_shard(sc, n_trials, 2, SEED, shard, N_SHARDS, sampling);
+    if (res == NULL)
+    {
+        return NULL;
+    }
+    partial_result_t part = { scenario_hash(sc), SEED, n_trials, sampling, N_SHARDS, 1,
+                              &shard, res };
+    int written = write_partial_result(path, &part);
+    free_sim_result(res);
+    return written == 0 ? read_partial_result(path) : NULL;
+}
+
+static int same_counts(sim_result_t *a, sim_result_t *b)
+{
+    if (a->n_trials != b->n_trials)
+    {
+        return 0;
+    }
+    for (size_t i = 0; i < a->n_hands; ++i)
+    {
+        if (a->wins[i] != b->wins[i] || a->ties[i] != b->ties[i])
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int main(void)
+{
+    char path[] = "/tmp/test-shard-XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0)
+    {
+        perror("mkstemp");
+        return EXIT_FAILURE;
+    }
+    close(fd);
+    future_cards_t *fc = init_future_cards();
+    scenario_t *sc = fc != NULL ? read_scenario("As Ks ?0 ?1 ?2 ?3 ?4\n7c 7d ?0 ?1 ?2 ?3 ?4\n", fc)
+                                : NULL;
+    if (sc == NULL)
+    {
+        free_future_cards(fc);
+        unlink(path);
+        return EXIT_FAILURE;
+    }
+
+    partial_result_t *total = run_shard(sc, 50000, SIM_PLAIN, 0, path);
+    partial_result_t *same = run_shard(sc, 50000, SIM_PLAIN, 1, path);
+    partial_result_t *last = run_shard(sc, 50000, SIM_PLAIN, 2, path);
+    partial_result_t *fewer = run_shard(sc, 9999, SIM_PLAIN, 1, path);
+    partial_result_t *stratified = run_shard(sc, 50000, SIM_STRATIFIED, 1, path);
+    partial_result_t *strata_first = run_shard(sc, 50000, SIM_STRATIFIED, 0, path);
+    partial_result_t *strata_last = run_shard(sc, 50000, SIM_STRATIFIED, 2, path);
+    sim_result_t *whole = simulate_shard(sc, 50000, 2, SEED, 0, 1, SIM_PLAIN);
+    if (total == NULL || same == NULL || last == NULL || fewer == NULL ||
+        stratified == NULL || strata_first == NULL || strata_last == NULL || whole == NULL)
+    {
+        fprintf(stderr, "Failed to run the shards.\n");
+        ++failures;
+    }
+    else
+    {
+        check(merge_partial_result(total, fewer) != 0,
+              "refuses a shard of a run with a different trial count");
+        check(total->n_covered == 1 && total->res->n_trials == shard_trials(50000, 0, N_SHARDS),
+              "leaves the total as it was after a refusal");
+        check(merge_partial_result(total, stratified) != 0,
+              "refuses a shard of a run with different sampling");
+        check(merge_partial_result(total, same) == 0, "merges a shard of the same run");
+        check(merge_partial_result(total, same) != 0, "refuses a shard merged before");
+        check(merge_partial_result(total, last) == 0 && total->n_covered == N_SHARDS,
+              "merges the last shard");
+        check(same_counts(total->res, whole), "merged shards count as the unsharded run");
+
+        unsigned long long n_batches = stratified->res->n_batches +
+                                       strata_first->res->n_batches + strata_last->res->n_batches;
+        check(stratified->res->n_batches > 0 && stratified->res->batch_size > 0,
+              "keeps the batches of a stratified shard");
+        check(merge_partial_result(strata_first, stratified) == 0 &&
+              merge_partial_result(strata_first, strata_last) == 0 &&
+              strata_first->res->n_batches == n_batches &&
+              sim_result_variance_factor(strata_first->res) > 0,
+              "merged stratified shards report their variance reduction");
+    }
+
+    free_sim_result(whole);
+    free_partial_result(strata_last);
+    free_partial_result(strata_first);
+    free_partial_result(stratified);
+    free_partial_result(fewer);
+    free_partial_result(last);
+    free_partial_result(same);
+    free_partial_result(total);
+    free_scenario(sc);
+    free_future_cards(fc);
+    unlink(path);
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}